@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+/* Read-only view of a contiguous array, which doesn't own its elements */
+template <typename T>
+class ArrayView {
+public:
+    ArrayView() = default;
+    ArrayView(const T* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+    template <typename Container>
+    ArrayView(const Container& container)
+        : data_(container.data())
+        , size_(container.size()) {
+    }
+
+    const T* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+    const T& back() const {
+        return data_[size_ - 1];
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
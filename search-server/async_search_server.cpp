@@ -0,0 +1,68 @@
+#include "async_search_server.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, QueryExecutor& executor, size_t queue_capacity)
+    : search_server_(search_server)
+    , executor_(executor)
+    , queue_capacity_(queue_capacity)
+{
+    if (queue_capacity == 0) {
+        throw invalid_argument("Capacity of the query queue must be positive"s);
+    }
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t thread_count, size_t queue_capacity)
+    : search_server_(search_server)
+    // the caller of ParallelFor is one of the executor threads, here all of them are workers
+    , own_executor_(make_unique<QueryExecutor>(max<size_t>(thread_count, 1) + 1))
+    , executor_(*own_executor_)
+    , queue_capacity_(queue_capacity)
+{
+    if (queue_capacity == 0) {
+        throw invalid_argument("Capacity of the query queue must be positive"s);
+    }
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    unique_lock lock(mutex_);
+    all_finished_.wait(lock, [this]() { return query_count_ == 0; });
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocumentsAsync(string raw_query, DocumentStatus status,
+                                                                  CancellationToken token) {
+    return Submit(move(token), [this, raw_query = move(raw_query), status](const CancellationToken& token) {
+        return search_server_.FindTopDocuments(raw_query, status, token);
+    });
+}
+
+future<AsyncSearchServer::MatchResult> AsyncSearchServer::MatchDocumentAsync(string raw_query, int document_id,
+                                                                             CancellationToken token) {
+    return Submit(move(token), [this, raw_query = move(raw_query), document_id](const CancellationToken&) {
+        return search_server_.MatchDocument(raw_query, document_id);
+    });
+}
+
+size_t AsyncSearchServer::GetQueueSize() const {
+    lock_guard guard(mutex_);
+    return query_count_;
+}
+
+void AsyncSearchServer::StartQuery() {
+    lock_guard guard(mutex_);
+    if (query_count_ >= queue_capacity_) {
+        throw overflow_error("Query queue is full"s);
+    }
+    ++query_count_;
+}
+
+void AsyncSearchServer::FinishQuery() {
+    // notified under the lock: the destructor can't return before notify_all
+    lock_guard guard(mutex_);
+    if (--query_count_ == 0) {
+        all_finished_.notify_all();
+    }
+}
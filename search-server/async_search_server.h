@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "cancellation.h"
+#include "document.h"
+#include "query_executor.h"
+#include "search_server.h"
+
+/* Default maximal number of queries in flight */
+const size_t ASYNC_QUEUE_CAPACITY = 4096;
+
+/* Asynchronous queries to a server. Queries are posted to a QueryExecutor, results are returned
+   by futures. So many queries can be in flight without a thread per query, and asynchronous queries
+   share threads with ProcessQueries and parallel search of the same executor.
+   Query is cancelled by its token: before it starts or while it runs (see SearchServer::FindTopDocuments
+   with token), its future gets OperationCancelled.
+   Server must not be changed while queries are in flight. Destructor waits for submitted queries */
+class AsyncSearchServer {
+public:
+    /* Queries run at workers of the executor (at the caller, if it has none).
+       Throws std::invalid_argument, if capacity is zero */
+    AsyncSearchServer(const SearchServer& search_server, QueryExecutor& executor,
+                      size_t queue_capacity = ASYNC_QUEUE_CAPACITY);
+    /* Same with an own executor of thread_count workers (at least one) */
+    explicit AsyncSearchServer(const SearchServer& search_server,
+                               size_t thread_count = std::thread::hardware_concurrency(),
+                               size_t queue_capacity = ASYNC_QUEUE_CAPACITY);
+    ~AsyncSearchServer();
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    /* Query is copied. Submitting methods throw std::overflow_error, if queue_capacity queries
+       are in flight */
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             CancellationToken token = CancellationToken());
+
+    /* Matched words refer to the dictionary of the server */
+    using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+    std::future<MatchResult> MatchDocumentAsync(std::string raw_query, int document_id,
+                                                CancellationToken token = CancellationToken());
+
+    /* Number of submitted queries, which aren't finished */
+    size_t GetQueueSize() const;
+
+    const SearchServer& GetSearchServer() const {
+        return search_server_;
+    }
+    QueryExecutor& GetExecutor() const {
+        return executor_;
+    }
+
+private:
+    const SearchServer& search_server_;
+    std::unique_ptr<QueryExecutor> own_executor_;
+    QueryExecutor& executor_;
+    size_t queue_capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable all_finished_;
+    size_t query_count_ = 0;
+
+    /* Posts function(token), its result or exception is passed to the returned future */
+    template <typename Function>
+    auto Submit(CancellationToken token, Function function)
+        -> std::future<std::invoke_result_t<Function&, const CancellationToken&>>;
+    void StartQuery();
+    void FinishQuery();
+};
+
+template <typename Function>
+inline auto AsyncSearchServer::Submit(CancellationToken token, Function function)
+    -> std::future<std::invoke_result_t<Function&, const CancellationToken&>> {
+    using Result = std::invoke_result_t<Function&, const CancellationToken&>;
+    StartQuery();
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+    auto task = [this, promise, token = std::move(token), function = std::move(function)]() mutable {
+        std::optional<Result> result;
+        std::exception_ptr error;
+        try {
+            token.ThrowIfCancelled();
+            result.emplace(function(token));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        /* This object may be destroyed after the query is finished, only the promise is used then */
+        FinishQuery();
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(*result));
+        }
+    };
+    try {
+        executor_.Post(std::move(task));
+    } catch (...) {
+        FinishQuery();
+        throw;
+    }
+    return future;
+}
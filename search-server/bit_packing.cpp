@@ -0,0 +1,169 @@
+#include "bit_packing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const uint32_t WORD_BITS = 32;
+const size_t LANE_SIZE = PACKED_BLOCK_SIZE / PACKED_LANE_COUNT;
+
+uint32_t GetMask(uint32_t bits) {
+    return bits == WORD_BITS ? ~0U : (1U << bits) - 1;
+}
+
+#if defined(__SSE2__)
+
+/* Calls store(j, lanes) with values j * 4 .. j * 4 + 3 for every j */
+template <typename Store>
+void UnpackLanes(const uint32_t* input, uint32_t bits, Store store) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(GetMask(bits)));
+    const __m128i* words = reinterpret_cast<const __m128i*>(input);
+    __m128i word = _mm_loadu_si128(words);
+    uint32_t shift = 0;
+    for (size_t j = 0; j < LANE_SIZE; ++j) {
+        __m128i lanes = _mm_srl_epi32(word, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        shift += bits;
+        if (shift >= WORD_BITS) {
+            shift -= WORD_BITS;
+            /* The last word is read only if the value continues in it */
+            if (j + 1 < LANE_SIZE || shift > 0) {
+                word = _mm_loadu_si128(++words);
+                if (shift > 0) {
+                    lanes = _mm_or_si128(lanes, _mm_sll_epi32(word, _mm_cvtsi32_si128(static_cast<int>(bits - shift))));
+                }
+            }
+        }
+        store(j, _mm_and_si128(lanes, mask));
+    }
+}
+
+#else
+
+/* Scalar version: lanes are decoded one by one */
+template <typename Store>
+void UnpackLanes(const uint32_t* input, uint32_t bits, Store store) {
+    const uint32_t mask = GetMask(bits);
+    uint32_t lanes[LANE_SIZE][PACKED_LANE_COUNT];
+    for (size_t lane = 0; lane < PACKED_LANE_COUNT; ++lane) {
+        size_t word = 0;
+        uint32_t shift = 0;
+        for (size_t j = 0; j < LANE_SIZE; ++j) {
+            uint32_t value = input[word * PACKED_LANE_COUNT + lane] >> shift;
+            shift += bits;
+            if (shift >= WORD_BITS) {
+                shift -= WORD_BITS;
+                ++word;
+                if (shift > 0) {
+                    value |= input[word * PACKED_LANE_COUNT + lane] << (bits - shift);
+                }
+            }
+            lanes[j][lane] = value & mask;
+        }
+    }
+    for (size_t j = 0; j < LANE_SIZE; ++j) {
+        store(j, lanes[j]);
+    }
+}
+
+#endif
+
+} // namespace
+
+uint32_t GetRequiredBits(const uint32_t* values, size_t count) {
+    uint32_t all_bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        all_bits |= values[i];
+    }
+    uint32_t bits = 0;
+    while (bits < WORD_BITS && (all_bits >> bits) != 0) {
+        ++bits;
+    }
+    return bits;
+}
+
+void PackBlock(const uint32_t* values, uint32_t bits, uint32_t* output) {
+    fill(output, output + PACKED_LANE_COUNT * bits, 0U);
+    if (bits == 0) return;
+    for (size_t lane = 0; lane < PACKED_LANE_COUNT; ++lane) {
+        size_t word = 0;
+        uint32_t shift = 0;
+        for (size_t j = 0; j < LANE_SIZE; ++j) {
+            const uint32_t value = values[j * PACKED_LANE_COUNT + lane];
+            output[word * PACKED_LANE_COUNT + lane] |= value << shift;
+            shift += bits;
+            if (shift >= WORD_BITS) {
+                shift -= WORD_BITS;
+                ++word;
+                if (shift > 0) {
+                    output[word * PACKED_LANE_COUNT + lane] |= value >> (bits - shift);
+                }
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t* input, uint32_t bits, uint32_t* values) {
+    if (bits == 0) {
+        fill(values, values + PACKED_BLOCK_SIZE, 0U);
+        return;
+    }
+#if defined(__SSE2__)
+    UnpackLanes(input, bits, [values](size_t j, __m128i lanes) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + j * PACKED_LANE_COUNT), lanes);
+    });
+#else
+    UnpackLanes(input, bits, [values](size_t j, const uint32_t* lanes) {
+        memcpy(values + j * PACKED_LANE_COUNT, lanes, PACKED_LANE_COUNT * sizeof(uint32_t));
+    });
+#endif
+}
+
+void UnpackDeltaBlock(const uint32_t* input, uint32_t bits, uint32_t base, uint32_t* values) {
+#if defined(__SSE2__)
+    __m128i sums = _mm_set1_epi32(static_cast<int>(base));
+    if (bits == 0) {
+        for (size_t j = 0; j < LANE_SIZE; ++j) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + j * PACKED_LANE_COUNT), sums);
+        }
+        return;
+    }
+    UnpackLanes(input, bits, [values, &sums](size_t j, __m128i lanes) {
+        sums = _mm_add_epi32(sums, lanes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + j * PACKED_LANE_COUNT), sums);
+    });
+#else
+    UnpackBlock(input, bits, values);
+    for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+        values[i] += i < PACKED_LANE_COUNT ? base : values[i - PACKED_LANE_COUNT];
+    }
+#endif
+}
+
+size_t WriteVarint(uint32_t value, uint8_t* output) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        output[size++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    output[size++] = static_cast<uint8_t>(value);
+    return size;
+}
+
+const uint8_t* ReadVarint(const uint8_t* input, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; input != end && shift < WORD_BITS; shift += 7) {
+        const uint8_t byte = *input++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return input;
+        }
+    }
+    return nullptr;
+}
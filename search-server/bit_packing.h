@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Bit packing of blocks of PACKED_BLOCK_SIZE unsigned 32-bit values with the same bit width.
+   Values are interleaved in 4 lanes: value i goes to lane i % 4, so that a packed block
+   of width b is 4 * b words, and SIMD decoding extracts 4 values per instruction.
+   SSE2 is used if it is available, otherwise the scalar implementation with the same layout */
+const size_t PACKED_BLOCK_SIZE = 128;
+const size_t PACKED_LANE_COUNT = 4;
+
+/* Bit width of the maximal value */
+uint32_t GetRequiredBits(const uint32_t* values, size_t count);
+
+/* Writes PACKED_LANE_COUNT * bits words to output */
+void PackBlock(const uint32_t* values, uint32_t bits, uint32_t* output);
+
+void UnpackBlock(const uint32_t* input, uint32_t bits, uint32_t* values);
+
+/* Decodes D4 deltas: values[i] = values[i - 4] + delta[i], values[-4 .. -1] are base */
+void UnpackDeltaBlock(const uint32_t* input, uint32_t bits, uint32_t base, uint32_t* values);
+
+/* Variable byte coding (7 bits per byte) for blocks shorter than PACKED_BLOCK_SIZE */
+size_t WriteVarint(uint32_t value, uint8_t* output);
+/* Returns nullptr, if the value doesn't end before end */
+const uint8_t* ReadVarint(const uint8_t* input, const uint8_t* end, uint32_t& value);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/* Thrown by operations, which were cancelled by their token */
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled()
+        : std::runtime_error("Operation is cancelled") {
+    }
+};
+
+/* Cooperative cancellation. Token is passed to an operation, which checks it at safe points,
+   source cancels all its tokens. Default token is never cancelled */
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool IsCancelled() const {
+        return state_ != nullptr && state_->load(std::memory_order_relaxed);
+    }
+
+    void ThrowIfCancelled() const {
+        if (IsCancelled()) {
+            throw OperationCancelled();
+        }
+    }
+
+private:
+    std::shared_ptr<const std::atomic<bool>> state_;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> state)
+        : state_(std::move(state)) {
+    }
+
+    friend class CancellationSource;
+};
+
+class CancellationSource {
+public:
+    CancellationSource()
+        : state_(std::make_shared<std::atomic<bool>>(false)) {
+    }
+
+    CancellationToken GetToken() const {
+        return CancellationToken(state_);
+    }
+
+    void Cancel() {
+        state_->store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return state_->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> state_;
+};
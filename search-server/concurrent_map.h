@@ -1,91 +1,385 @@
 #pragma once
 
-#include <string>
-#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <execution>
 #include <map>
+#include <memory>
+#include <numeric>
 #include <set>
-#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Size of the cache line. Buckets are aligned by it, so that locks of neighbour buckets don't share a line */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+enum class ConcurrentMode {
+    SPINLOCK,       /* every bucket is guarded by its own spinlock */
+    ATOMIC_ADD,     /* lock-free table of fixed capacity, values are changed only by Add() */
+};
+
+namespace concurrent_detail {
+
+/* Well mixed 64-bit hash of integer key (splitmix64 finalizer) */
+inline uint64_t Hash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+inline size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+class SpinLock {
+public:
+    void lock() {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            /* Yield instead of busy waiting: the owner may be waiting for the same core */
+            while (locked_.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock() {
+        locked_.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> locked_{false};
+};
 
+/* Open addressing table with linear probing. Not thread safe */
 template <typename Key, typename Value>
-class ConcurrentMap {
+class HashTable {
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    explicit HashTable(size_t expected_size = 0)
+        : slots_(RoundUpToPowerOfTwo(std::max<size_t>(8, expected_size * 2))) {
+    }
+
+    Value& operator[](const Key& key) {
+        if ((size_ + 1) * 2 > slots_.size()) {
+            Grow();
+        }
+        Slot& slot = slots_[FindPosition(key)];
+        if (!slot.is_used) {
+            slot.key = key;
+            slot.is_used = true;
+            ++size_;
+        }
+        return slot.value;
+    }
+
+    /* Backward shift deletion, so that no tombstones are left */
+    size_t Erase(const Key& key) {
+        const size_t mask = slots_.size() - 1;
+        size_t hole = FindPosition(key);
+        if (!slots_[hole].is_used) {
+            return 0;
+        }
+        for (size_t i = (hole + 1) & mask; slots_[i].is_used; i = (i + 1) & mask) {
+            const size_t home = GetHome(slots_[i].key);
+            /* Slot i may fill the hole, if its home is not in the cyclic range (hole, i] */
+            const bool is_between = hole < i ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!is_between) {
+                slots_[hole] = std::move(slots_[i]);
+                hole = i;
+            }
+        }
+        slots_[hole] = Slot{};
+        --size_;
+        return 1;
+    }
 
-    struct SubMap {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    size_t GetSize() const {
+        return size_;
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const Slot& slot : slots_) {
+            if (slot.is_used) {
+                function(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool is_used = false;
     };
 
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+
+    size_t GetHome(const Key& key) const {
+        return Hash(static_cast<uint64_t>(key)) & (slots_.size() - 1);
+    }
+
+    size_t FindPosition(const Key& key) const {
+        const size_t mask = slots_.size() - 1;
+        size_t i = GetHome(key);
+        while (slots_[i].is_used && slots_[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void Grow() {
+        std::vector<Slot> slots(slots_.size() * 2);
+        slots_.swap(slots);
+        for (Slot& slot : slots) {
+            if (slot.is_used) {
+                slots_[FindPosition(slot.key)] = std::move(slot);
+            }
+        }
+    }
+};
+
+/* Sorts entries, which consist of sorted runs [bounds[i], bounds[i + 1]).
+   Pairs of neighbour runs are merged in parallel, so k runs are merged in log(k) rounds */
+template <typename Entry, typename Less>
+void MergeSortedRuns(std::vector<Entry>& entries, std::vector<size_t> bounds, Less less) {
+    std::vector<Entry> buffer(entries.size());
+    while (bounds.size() > 2) {
+        std::vector<size_t> pairs(bounds.size() / 2);     /* runs are bounds.size() - 1 */
+        std::iota(pairs.begin(), pairs.end(), 0);
+        std::for_each(std::execution::par, pairs.begin(), pairs.end(), [&](size_t pair) {
+            const size_t first = bounds[pair * 2];
+            const size_t middle = bounds[pair * 2 + 1];
+            const size_t last = pair * 2 + 2 < bounds.size() ? bounds[pair * 2 + 2] : middle;
+            std::merge(std::make_move_iterator(entries.begin() + first), std::make_move_iterator(entries.begin() + middle),
+                       std::make_move_iterator(entries.begin() + middle), std::make_move_iterator(entries.begin() + last),
+                       buffer.begin() + first, less);
+        });
+        entries.swap(buffer);
+
+        std::vector<size_t> merged_bounds;
+        for (size_t i = 0; i < bounds.size(); i += 2) {
+            merged_bounds.push_back(bounds[i]);
+        }
+        if (merged_bounds.back() != bounds.back()) {
+            merged_bounds.push_back(bounds.back());
+        }
+        bounds.swap(merged_bounds);
+    }
+}
+
+} // namespace concurrent_detail
+
+/* Concurrent hash map with integer keys.
+   SPINLOCK mode: keys are spread over buckets by hash, every bucket is an open addressing table
+   guarded by its own spinlock.
+   ATOMIC_ADD mode: one lock-free table of fixed capacity for arithmetic values. Keys are inserted
+   by compare-and-swap, values are changed by atomic addition only.
+   Build* methods must not run concurrently with writers. */
+template <typename Key, typename Value, ConcurrentMode Mode = ConcurrentMode::SPINLOCK>
+class ConcurrentMap {
+public:
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    static_assert(Mode != ConcurrentMode::ATOMIC_ADD || std::is_arithmetic_v<Value>,
+                  "ATOMIC_ADD mode supports only arithmetic values");
+
     struct Access {
         private:
-            std::lock_guard<std::mutex> mutex_;
+            std::lock_guard<concurrent_detail::SpinLock> guard_;
         public:
             Value& ref_to_value;
 
-            Access(SubMap& submap, const Key& key) : mutex_{submap.mutex}, ref_to_value{submap.map[key]} {}
+            Access(concurrent_detail::SpinLock& lock, concurrent_detail::HashTable<Key, Value>& table, const Key& key)
+                : guard_{lock}, ref_to_value{table[key]} {}
     };
 
-    explicit ConcurrentMap(size_t bucket_count) : maps_{bucket_count} {}
+    /* In ATOMIC_ADD mode bucket_count is ignored and expected_size is the maximal number of keys */
+    explicit ConcurrentMap(size_t bucket_count, size_t expected_size = 0) {
+        if constexpr (Mode == ConcurrentMode::SPINLOCK) {
+            buckets_.reserve(bucket_count);
+            for (size_t i = 0; i < bucket_count; ++i) {
+                buckets_.emplace_back(expected_size / bucket_count);
+            }
+        } else {
+            slot_count_ = concurrent_detail::RoundUpToPowerOfTwo(std::max<size_t>(8, expected_size * 2));
+            slots_ = std::make_unique<AtomicSlot[]>(slot_count_);
+        }
+    }
 
     Access operator[](const Key& key) {
-        SubMap& submap = maps_[static_cast<uint64_t>(key) % maps_.size()];
-        return {submap, key};
+        static_assert(Mode == ConcurrentMode::SPINLOCK, "operator[] is available in SPINLOCK mode only");
+        Bucket& bucket = GetBucket(key);
+        return {bucket.lock, bucket.table, key};
+    }
+
+    /* Adds delta to the value of the key. Missing key is inserted with zero value */
+    void Add(const Key& key, Value delta) {
+        if constexpr (Mode == ConcurrentMode::SPINLOCK) {
+            Bucket& bucket = GetBucket(key);
+            std::lock_guard guard(bucket.lock);
+            bucket.table[key] += delta;
+        } else {
+            std::atomic<Value>& value = FindOrInsertAtomic(key);
+            Value expected = value.load(std::memory_order_relaxed);
+            while (!value.compare_exchange_weak(expected, expected + delta, std::memory_order_relaxed)) {
+            }
+        }
     }
 
     size_t Erase(const Key& key) {
-        SubMap& submap = maps_[static_cast<uint64_t>(key) % maps_.size()];
-        std::lock_guard<std::mutex> mutex_{submap.mutex};
-        return submap.map.erase(key);
+        static_assert(Mode == ConcurrentMode::SPINLOCK, "Erase is available in SPINLOCK mode only");
+        Bucket& bucket = GetBucket(key);
+        std::lock_guard guard(bucket.lock);
+        return bucket.table.Erase(key);
+    }
+
+    /* Pairs <key, value> sorted by key. Every bucket is drained into its own part of
+       the pre-sized result and sorted, then the parts are merged */
+    std::vector<std::pair<Key, Value>> BuildSortedVector() {
+        std::vector<std::pair<Key, Value>> result;
+        std::vector<size_t> bounds{0};
+        if constexpr (Mode == ConcurrentMode::SPINLOCK) {
+            for (const Bucket& bucket : buckets_) {
+                bounds.push_back(bounds.back() + bucket.table.GetSize());
+            }
+            result.resize(bounds.back());
+            std::vector<size_t> indexes(buckets_.size());
+            std::iota(indexes.begin(), indexes.end(), 0);
+            std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+                Bucket& bucket = buckets_[index];
+                std::lock_guard guard(bucket.lock);
+                auto it = result.begin() + bounds[index];
+                bucket.table.ForEach([&it](const Key& key, const Value& value) {
+                    *it++ = {key, value};
+                });
+                std::sort(result.begin() + bounds[index], it, LessKey);
+            });
+        } else {
+            for (size_t i = 0; i < slot_count_; ++i) {
+                if (slots_[i].state.load(std::memory_order_acquire) == AtomicSlot::READY) {
+                    result.push_back({slots_[i].key, slots_[i].value.load(std::memory_order_relaxed)});
+                }
+            }
+            std::sort(std::execution::par, result.begin(), result.end(), LessKey);
+            bounds.push_back(result.size());
+        }
+        concurrent_detail::MergeSortedRuns(result, std::move(bounds), LessKey);
+        return result;
     }
 
+    /* Kept for compatibility, BuildSortedVector() is cheaper */
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> result;
-        for (auto& [mutex, map] : maps_) {
-            std::lock_guard<std::mutex> mutex_{mutex};
-            result.insert(begin(map), end(map));
+        for (auto& [key, value] : BuildSortedVector()) {
+            result.emplace_hint(result.end(), key, std::move(value));
         }
         return result;
     }
 
 private:
-    std::vector<SubMap> maps_;
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        concurrent_detail::SpinLock lock;
+        concurrent_detail::HashTable<Key, Value> table;
+
+        explicit Bucket(size_t expected_size) : table(expected_size) {}
+        Bucket(Bucket&& other) : table(std::move(other.table)) {}
+    };
+
+    struct AtomicSlot {
+        static constexpr uint8_t EMPTY = 0;
+        static constexpr uint8_t WRITING = 1;
+        static constexpr uint8_t READY = 2;
+
+        std::atomic<uint8_t> state{EMPTY};
+        Key key{};
+        std::atomic<Value> value{};
+    };
+
+    std::vector<Bucket> buckets_;                   /* SPINLOCK mode */
+    std::unique_ptr<AtomicSlot[]> slots_;           /* ATOMIC_ADD mode */
+    size_t slot_count_ = 0;
+
+    static bool LessKey(const std::pair<Key, Value>& lhs, const std::pair<Key, Value>& rhs) {
+        return lhs.first < rhs.first;
+    }
+
+    Bucket& GetBucket(const Key& key) {
+        return buckets_[(concurrent_detail::Hash(static_cast<uint64_t>(key)) >> 32) % buckets_.size()];
+    }
+
+    std::atomic<Value>& FindOrInsertAtomic(const Key& key) {
+        const size_t mask = slot_count_ - 1;
+        size_t i = concurrent_detail::Hash(static_cast<uint64_t>(key)) & mask;
+        for (size_t probe = 0; probe < slot_count_; ++probe, i = (i + 1) & mask) {
+            AtomicSlot& slot = slots_[i];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            if (state == AtomicSlot::EMPTY) {
+                if (slot.state.compare_exchange_strong(state, AtomicSlot::WRITING, std::memory_order_acquire)) {
+                    slot.key = key;
+                    slot.state.store(AtomicSlot::READY, std::memory_order_release);
+                    return slot.value;
+                }
+            }
+            /* Another thread is writing the key of this slot */
+            while (state == AtomicSlot::WRITING) {
+                std::this_thread::yield();
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (slot.key == key) {
+                return slot.value;
+            }
+        }
+        throw std::length_error("ConcurrentMap capacity is exceeded");
+    }
 };
 
+/* Concurrent set of integer keys, built the same way as ConcurrentMap in SPINLOCK mode */
 template <typename Key>
 class ConcurrentSet {
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
-    struct SubSet {
-        std::mutex mutex;
-        std::set<Key> set;
-    };
+    static_assert(std::is_integral_v<Key>, "ConcurrentSet supports only integer keys");
 
-    struct Access {
-        private:
-            std::lock_guard<std::mutex> mutex_;
-        public:
-            Key& ref_to_value;
-
-            Access(SubSet& subset, const Key& key) : mutex_{subset.mutex}, ref_to_value{*(subset.set.insert(key).first)} {}
-    };
+    explicit ConcurrentSet(size_t bucket_count, size_t expected_size = 0)
+        : map_(bucket_count, expected_size) {
+    }
 
-    explicit ConcurrentSet(size_t bucket_count) : sets_{bucket_count} {}
+    void Insert(const Key& key) {
+        map_[key];
+    }
 
-    Access operator[](const Key& key) {
-        SubSet& subset = sets_[static_cast<uint64_t>(key) % sets_.size()];
-        return {subset, key};
+    size_t Erase(const Key& key) {
+        return map_.Erase(key);
     }
 
-    std::set<Key> BuildOrdinarySet() {
-        std::set<Key> result;
-        for (auto& [mutex, set] : sets_) {
-            std::lock_guard<std::mutex> mutex_{mutex};
-            result.insert(begin(set), end(set));
+    /* Keys sorted in ascending order */
+    std::vector<Key> BuildSortedVector() {
+        std::vector<Key> result;
+        const auto entries = map_.BuildSortedVector();
+        result.reserve(entries.size());
+        for (const auto& entry : entries) {
+            result.push_back(entry.first);
         }
         return result;
     }
 
+    /* Kept for compatibility, BuildSortedVector() is cheaper */
+    std::set<Key> BuildOrdinarySet() {
+        const std::vector<Key> keys = BuildSortedVector();
+        return {keys.begin(), keys.end()};
+    }
+
 private:
-    std::vector<SubSet> sets_;
-};
\ No newline at end of file
+    struct Empty {};
+    ConcurrentMap<Key, Empty> map_;
+};
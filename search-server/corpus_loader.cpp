@@ -0,0 +1,180 @@
+#include "corpus_loader.h"
+
+#include <charconv>
+#include <execution>
+#include <future>
+#include <iomanip>
+#include <optional>
+
+#include "mapped_file.h"
+
+using namespace std;
+
+namespace {
+
+/* Parsed lines of one chunk of the corpus */
+struct CorpusChunk {
+    vector<DocumentRecord> records;
+    vector<size_t> record_lines;
+    vector<size_t> error_lines;
+    size_t end = 0;             /* offset of the next chunk */
+    size_t next_line = 0;       /* number of the first line of the next chunk */
+};
+
+/* Cuts the field up to the next tab */
+optional<string_view> CutField(string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        return nullopt;
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+optional<int> ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || end != text.data() + text.size()) {
+        return nullopt;
+    }
+    return value;
+}
+
+optional<DocumentStatus> ParseStatus(string_view text) {
+    if (text == "ACTUAL"sv) return DocumentStatus::ACTUAL;
+    if (text == "IRRELEVANT"sv) return DocumentStatus::IRRELEVANT;
+    if (text == "BANNED"sv) return DocumentStatus::BANNED;
+    if (text == "REMOVED"sv) return DocumentStatus::REMOVED;
+    return nullopt;
+}
+
+optional<DocumentRecord> ParseRecord(string_view line) {
+    const auto id = CutField(line);
+    const auto status = CutField(line);
+    const auto ratings = CutField(line);
+    if (!id || !status || !ratings) {
+        return nullopt;
+    }
+    DocumentRecord record;
+    const auto parsed_id = ParseInt(*id);
+    const auto parsed_status = ParseStatus(*status);
+    if (!parsed_id || !parsed_status) {
+        return nullopt;
+    }
+    record.id = *parsed_id;
+    record.status = *parsed_status;
+    for (const string_view rating : SplitIntoWords(*ratings)) {
+        const auto parsed_rating = ParseInt(rating);
+        if (!parsed_rating) {
+            return nullopt;
+        }
+        record.ratings.push_back(*parsed_rating);
+    }
+    record.text = line;
+    return record;
+}
+
+/* Parses lines starting at begin, until the chunk is at least chunk_size bytes long.
+   Chunk has at least one line */
+CorpusChunk ParseChunk(string_view corpus, size_t begin, size_t chunk_size, size_t first_line) {
+    CorpusChunk chunk;
+    size_t line_number = first_line;
+    size_t position = begin;
+    while (position < corpus.size() && (position == begin || position - begin < chunk_size)) {
+        size_t line_end = corpus.find('\n', position);
+        if (line_end == corpus.npos) {
+            line_end = corpus.size();
+        }
+        string_view line = corpus.substr(position, line_end - position);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            if (auto record = ParseRecord(line)) {
+                chunk.records.push_back(move(*record));
+                chunk.record_lines.push_back(line_number);
+            } else {
+                chunk.error_lines.push_back(line_number);
+            }
+        }
+        position = min(line_end + 1, corpus.size());
+        ++line_number;
+    }
+    chunk.end = position;
+    chunk.next_line = line_number;
+    return chunk;
+}
+
+void AddChunk(SearchServer& server, const CorpusChunk& chunk, CorpusLoadStats& stats) {
+    const vector<exception_ptr> errors = server.AddDocuments(execution::par, chunk.records);
+    /* Lines of the chunk are reported in order: malformed lines and records are merged */
+    size_t error_line = 0;
+    for (size_t i = 0; i < errors.size(); ++i) {
+        for (; error_line < chunk.error_lines.size() && chunk.error_lines[error_line] < chunk.record_lines[i]; ++error_line) {
+            stats.error_lines.push_back(chunk.error_lines[error_line]);
+        }
+        if (errors[i]) {
+            stats.error_lines.push_back(chunk.record_lines[i]);
+        } else {
+            ++stats.document_count;
+        }
+    }
+    stats.error_lines.insert(stats.error_lines.end(), chunk.error_lines.begin() + error_line, chunk.error_lines.end());
+}
+
+} // namespace
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    const double seconds = chrono::duration<double>(duration).count();
+    return seconds > 0.0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+double CorpusLoadStats::GetDocumentsPerSecond() const {
+    const double seconds = chrono::duration<double>(duration).count();
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+CorpusLoadStats LoadCorpusFile(SearchServer& server, const string& path, size_t chunk_size) {
+    const MappedFile file(path);
+    file.AdviseSequential();
+    return LoadCorpus(server, string_view(file.GetData(), file.GetSize()), chunk_size);
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& server, string_view corpus, size_t chunk_size) {
+    const auto start = chrono::steady_clock::now();
+    CorpusLoadStats stats;
+    stats.byte_count = corpus.size();
+
+    const auto parse = [corpus, chunk_size](size_t begin, size_t first_line) {
+        return ParseChunk(corpus, begin, chunk_size, first_line);
+    };
+    // parsing of the next chunk runs at another thread, while the current one is added
+    CorpusChunk chunk = parse(0, 1);
+    for (;;) {
+        future<CorpusChunk> next_chunk;
+        if (chunk.end < corpus.size()) {
+            next_chunk = async(launch::async, parse, chunk.end, chunk.next_line);
+        }
+        AddChunk(server, chunk, stats);
+        if (!next_chunk.valid()) break;
+        chunk = next_chunk.get();
+    }
+
+    stats.duration = chrono::steady_clock::now() - start;
+    return stats;
+}
+
+ostream& operator<<(ostream& output, const CorpusLoadStats& stats) {
+    const auto flags = output.flags();
+    const auto precision = output.precision();
+    output << stats.document_count << " documents, "s
+           << stats.error_lines.size() << " errors, "s
+           << fixed << setprecision(1) << stats.byte_count / (1024.0 * 1024.0) << " MB in "s
+           << chrono::duration_cast<chrono::milliseconds>(stats.duration).count() << " ms ("s
+           << stats.GetMegabytesPerSecond() << " MB/s, "s
+           << setprecision(0) << stats.GetDocumentsPerSecond() << " documents/s)"s;
+    output.flags(flags);
+    output.precision(precision);
+    return output;
+}
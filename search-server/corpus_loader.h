@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+
+/* Bulk loading of documents into SearchServer.
+   Corpus is a text with one document per line:
+   <id> TAB <status> TAB <ratings separated by spaces> TAB <text>
+   Status is ACTUAL, IRRELEVANT, BANNED or REMOVED. Empty lines are skipped.
+   Corpus is split into chunks at line ends. While documents of a chunk are added
+   (AddDocuments, tokenized in parallel), the next chunk is parsed at another thread,
+   so reading of the file overlaps with indexing. Texts are passed to the server as views
+   of the corpus without copying */
+const size_t CORPUS_CHUNK_SIZE = 4 << 20;
+
+struct CorpusLoadStats {
+    size_t byte_count = 0;
+    size_t document_count = 0;          /* added documents */
+    /* Numbers (from 1) of lines, which are malformed or were rejected by the server */
+    std::vector<size_t> error_lines;
+    std::chrono::steady_clock::duration duration{};
+
+    double GetMegabytesPerSecond() const;
+    double GetDocumentsPerSecond() const;
+};
+
+/* Loads the corpus from the file, which is mapped to memory.
+   Throws std::system_error, if the file can't be opened */
+CorpusLoadStats LoadCorpusFile(SearchServer& server, const std::string& path,
+                               size_t chunk_size = CORPUS_CHUNK_SIZE);
+/* Loads the corpus from memory */
+CorpusLoadStats LoadCorpus(SearchServer& server, std::string_view corpus,
+                           size_t chunk_size = CORPUS_CHUNK_SIZE);
+
+/* Output: "<documents> documents, <errors> errors, <MB> MB in <ms> ms (<MB/s> MB/s, <documents/s> documents/s)" */
+std::ostream& operator<<(std::ostream& output, const CorpusLoadStats& stats);
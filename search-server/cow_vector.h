@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/* Vector split into chunks of CHUNK_SIZE elements. Copies of the vector share chunks,
+   a shared chunk is copied on first write to it (copy-on-write). So a copy costs
+   O(size / CHUNK_SIZE), and a change copies at most one chunk.
+   Chunks are allocated from the memory resource of the vector */
+template <typename T>
+class CowVector {
+public:
+    static constexpr size_t CHUNK_SIZE = 1024;
+
+    explicit CowVector(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : chunks_(resource) {
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const T& operator[](size_t index) const {
+        return (*chunks_[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    /* Element, which can be changed without affecting copies of the vector */
+    T& GetMutable(size_t index) {
+        return GetMutableChunk(index / CHUNK_SIZE)[index % CHUNK_SIZE];
+    }
+
+    T& emplace_back() {
+        if (size_ % CHUNK_SIZE == 0) {
+            chunks_.push_back(MakeChunk(nullptr));
+            chunks_.back()->reserve(CHUNK_SIZE);
+        }
+        ++size_;
+        return GetMutableChunk(chunks_.size() - 1).emplace_back();
+    }
+
+    std::pmr::memory_resource* GetMemoryResource() const {
+        return chunks_.get_allocator().resource();
+    }
+
+private:
+    using Chunk = std::pmr::vector<T>;
+
+    std::pmr::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+
+    std::shared_ptr<Chunk> MakeChunk(const Chunk* other) const {
+        const std::pmr::polymorphic_allocator<Chunk> allocator(GetMemoryResource());
+        if (other == nullptr) {
+            return std::allocate_shared<Chunk>(allocator);
+        }
+        return std::allocate_shared<Chunk>(allocator, *other);
+    }
+
+    Chunk& GetMutableChunk(size_t chunk) {
+        /* Other copies of the vector keep reading the old chunk */
+        if (chunks_[chunk].use_count() > 1) {
+            auto copy = MakeChunk(chunks_[chunk].get());
+            copy->reserve(CHUNK_SIZE);
+            chunks_[chunk] = std::move(copy);
+        }
+        return *chunks_[chunk];
+    }
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <ostream>
+#include <string_view>
+#include <vector>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -23,4 +25,13 @@ struct Document {
     int rating = 0;
 };
 
+/* Document for batch adding to search server (SearchServer::AddDocuments).
+   Text is not copied, it must stay valid during the call */
+struct DocumentRecord {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream& operator<<(std::ostream& output, Document document);
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* Open addressing hash table <document ordinal, relevance> for scoring by one thread.
+   Documents rejected by the filter are kept too, so that filter is checked once per document */
+class DocumentAccumulator {
+public:
+    struct Entry {
+        int ordinal = EMPTY;
+        bool is_accepted = false;
+        double relevance = 0.0;
+    };
+
+    explicit DocumentAccumulator(size_t expected_count = 0) {
+        while ((size_t{1} << capacity_bits_) < expected_count * 2) {
+            ++capacity_bits_;
+        }
+        entries_.resize(size_t{1} << capacity_bits_);
+    }
+
+    /* Returns entry of the document and true, if the document is new.
+       New entry must be initialized by caller */
+    std::pair<Entry&, bool> Insert(int ordinal) {
+        if ((size_ + 1) * 2 > entries_.size()) {
+            Grow();
+        }
+        Entry& entry = Find(ordinal);
+        const bool is_new = entry.ordinal == EMPTY;
+        if (is_new) {
+            entry.ordinal = ordinal;
+            ++size_;
+        }
+        return {entry, is_new};
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const Entry& entry : entries_) {
+            if (entry.ordinal != EMPTY) {
+                function(entry);
+            }
+        }
+    }
+
+private:
+    static constexpr int EMPTY = -1;     /* ordinals are non-negative */
+
+    std::vector<Entry> entries_;
+    size_t size_ = 0;
+    int capacity_bits_ = 4;
+
+    Entry& Find(int ordinal) {
+        const size_t mask = entries_.size() - 1;
+        // Fibonacci hashing: high bits of the product are well mixed
+        size_t index = (static_cast<uint64_t>(static_cast<uint32_t>(ordinal)) * 11400714819323198485ull)
+                       >> (64 - capacity_bits_);
+        while (entries_[index].ordinal != EMPTY && entries_[index].ordinal != ordinal) {
+            index = (index + 1) & mask;
+        }
+        return entries_[index];
+    }
+
+    void Grow() {
+        ++capacity_bits_;
+        std::vector<Entry> entries(size_t{1} << capacity_bits_);
+        entries_.swap(entries);
+        for (const Entry& entry : entries) {
+            if (entry.ordinal != EMPTY) {
+                Find(entry.ordinal) = entry;
+            }
+        }
+    }
+};
@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include "document_bitmap.h"
+
+using namespace std;
+
+void DocumentBitmap::Add(int document_id) {
+    const uint32_t key = static_cast<uint32_t>(document_id) >> CHUNK_BITS;
+    const uint16_t value = static_cast<uint16_t>(document_id);
+
+    /* Documents are mostly added in ascending order, so the last chunk is checked first */
+    auto chunk = chunks_.end();
+    if (chunks_.empty() || chunks_.back().key != key) {
+        chunk = FindChunk(key);
+        if (chunk == chunks_.end() || chunk->key != key) {
+            pmr::memory_resource* resource = chunks_.get_allocator().resource();
+            chunk = chunks_.insert(chunk, Chunk{key, pmr::vector<uint16_t>(resource), pmr::vector<uint64_t>(resource)});
+        }
+    } else {
+        chunk = prev(chunks_.end());
+    }
+
+    if (!chunk->bits.empty()) {
+        chunk->bits[value / 64] |= uint64_t{1} << (value % 64);
+        return;
+    }
+    auto& values = chunk->values;
+    if (values.empty() || values.back() < value) {
+        values.push_back(value);
+    } else {
+        const auto it = lower_bound(values.begin(), values.end(), value);
+        if (*it == value) return;
+        values.insert(it, value);
+    }
+    if (values.size() > MAX_SPARSE_SIZE) {
+        chunk->bits.assign(CHUNK_SIZE / 64, 0);
+        for (const uint16_t sparse_value : values) {
+            chunk->bits[sparse_value / 64] |= uint64_t{1} << (sparse_value % 64);
+        }
+        values.clear();
+        values.shrink_to_fit();
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    const uint32_t key = static_cast<uint32_t>(document_id) >> CHUNK_BITS;
+    const uint16_t value = static_cast<uint16_t>(document_id);
+
+    const auto chunk = FindChunk(key);
+    if (chunk == chunks_.end() || chunk->key != key) {
+        return false;
+    }
+    if (!chunk->bits.empty()) {
+        return (chunk->bits[value / 64] >> (value % 64)) & 1;
+    }
+    return binary_search(chunk->values.begin(), chunk->values.end(), value);
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    const uint32_t key = static_cast<uint32_t>(document_id) >> CHUNK_BITS;
+    const uint16_t value = static_cast<uint16_t>(document_id);
+
+    const auto chunk = FindChunk(key);
+    if (chunk == chunks_.end() || chunk->key != key) {
+        return;
+    }
+    if (!chunk->bits.empty()) {
+        /* Dense chunk is kept dense, it is likely to be refilled */
+        chunk->bits[value / 64] &= ~(uint64_t{1} << (value % 64));
+        return;
+    }
+    auto& values = chunk->values;
+    const auto it = lower_bound(values.begin(), values.end(), value);
+    if (it != values.end() && *it == value) {
+        values.erase(it);
+        if (values.empty()) {
+            chunks_.erase(chunk);
+        }
+    }
+}
+
+pmr::vector<DocumentBitmap::Chunk>::iterator DocumentBitmap::FindChunk(uint32_t key) {
+    return lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& chunk, uint32_t key) {
+        return chunk.key < key; });
+}
+
+pmr::vector<DocumentBitmap::Chunk>::const_iterator DocumentBitmap::FindChunk(uint32_t key) const {
+    return lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& chunk, uint32_t key) {
+        return chunk.key < key; });
+}
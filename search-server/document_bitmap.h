@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/* Compact set of document ids (roaring-like).
+   Ids are split into chunks of 2^16 ids by high bits. A chunk keeps a sorted array of low bits,
+   while it is sparse, and turns into a plain bitset of 8 KB, when it becomes dense. */
+class DocumentBitmap {
+public:
+    explicit DocumentBitmap(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : chunks_(resource) {
+    }
+
+    /* document_id must be non-negative */
+    void Add(int document_id);
+    void Remove(int document_id);
+    bool Contains(int document_id) const;
+
+    bool IsEmpty() const {
+        return chunks_.empty();
+    }
+
+private:
+    static constexpr int CHUNK_BITS = 16;
+    static constexpr size_t CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    /* Sparse chunk is not bigger than the bitset */
+    static constexpr size_t MAX_SPARSE_SIZE = CHUNK_SIZE / 16;
+
+    struct Chunk {
+        uint32_t key;
+        std::pmr::vector<uint16_t> values;      /* sorted, used while bits is empty */
+        std::pmr::vector<uint64_t> bits;
+    };
+    /* Sorted by key */
+    std::pmr::vector<Chunk> chunks_;
+
+    std::pmr::vector<Chunk>::iterator FindChunk(uint32_t key);
+    std::pmr::vector<Chunk>::const_iterator FindChunk(uint32_t key) const;
+};
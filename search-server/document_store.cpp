@@ -0,0 +1,99 @@
+#include "document_store.h"
+
+using namespace std;
+
+DocumentStore::DocumentStore(pmr::memory_resource* resource)
+    : ids_(resource)
+    , ratings_(resource)
+    , statuses_(resource)
+    , removed_(resource)
+    , ordinals_(resource) {
+}
+
+DocumentOrdinal DocumentStore::Add(int document_id, int rating, DocumentStatus status) {
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(ids_.size());
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+    removed_.push_back(false);
+    ordinals_.emplace(document_id, ordinal);
+    return ordinal;
+}
+
+void DocumentStore::Remove(DocumentOrdinal ordinal) {
+    removed_[ordinal] = true;
+    ordinals_.erase(ids_[ordinal]);
+}
+
+DocumentOrdinal DocumentStore::Find(int document_id) const {
+    const auto it = ordinals_.find(document_id);
+    return it == ordinals_.end() ? NO_DOCUMENT : it->second;
+}
+
+size_t DocumentStore::GetSize() const {
+    return ordinals_.size();
+}
+
+size_t DocumentStore::GetOrdinalCount() const {
+    return ids_.size();
+}
+
+pmr::memory_resource* DocumentStore::GetMemoryResource() const {
+    return ids_.get_allocator().resource();
+}
+
+vector<DocumentOrdinal> DocumentStore::Compact() {
+    vector<DocumentOrdinal> new_ordinals(GetOrdinalCount(), NO_DOCUMENT);
+    DocumentOrdinal new_ordinal = 0;
+    for (DocumentOrdinal ordinal = 0; ordinal < static_cast<DocumentOrdinal>(GetOrdinalCount()); ++ordinal) {
+        if (removed_[ordinal]) continue;
+        /* new_ordinal <= ordinal, so columns are compacted in place */
+        ids_[new_ordinal] = ids_[ordinal];
+        ratings_[new_ordinal] = ratings_[ordinal];
+        statuses_[new_ordinal] = statuses_[ordinal];
+        ordinals_[ids_[new_ordinal]] = new_ordinal;
+        new_ordinals[ordinal] = new_ordinal++;
+    }
+    ids_.resize(new_ordinal);
+    ratings_.resize(new_ordinal);
+    statuses_.resize(new_ordinal);
+    removed_.assign(new_ordinal, false);
+    return new_ordinals;
+}
+
+DocumentStore::IdIterator DocumentStore::begin() const {
+    return IdIterator(*this, 0);
+}
+
+DocumentStore::IdIterator DocumentStore::end() const {
+    return IdIterator(*this, static_cast<DocumentOrdinal>(GetOrdinalCount()));
+}
+
+void DocumentStore::Save(SnapshotWriter& writer) const {
+    writer.WriteArray<int>(ids_);
+    writer.WriteArray<int>(ratings_);
+    writer.WriteArray<DocumentStatus>(statuses_);
+    const vector<uint8_t> removed(removed_.begin(), removed_.end());
+    writer.WriteArray<uint8_t>(removed);
+}
+
+void DocumentStore::Load(SnapshotReader& reader) {
+    const auto ids = reader.ReadArray<int>();
+    const auto ratings = reader.ReadArray<int>();
+    const auto statuses = reader.ReadArray<DocumentStatus>();
+    const auto removed = reader.ReadArray<uint8_t>();
+    if (ratings.size() != ids.size() || statuses.size() != ids.size() || removed.size() != ids.size()) {
+        throw SnapshotError("Snapshot has inconsistent document columns"s);
+    }
+    ids_.assign(ids.begin(), ids.end());
+    ratings_.assign(ratings.begin(), ratings.end());
+    statuses_.assign(statuses.begin(), statuses.end());
+    removed_.assign(removed.begin(), removed.end());
+    ordinals_.reserve(ids.size());
+    for (DocumentOrdinal ordinal = 0; ordinal < static_cast<DocumentOrdinal>(ids.size()); ++ordinal) {
+        if (removed_[ordinal]) continue;
+        if (ids_[ordinal] < 0 || !ordinals_.emplace(ids_[ordinal], ordinal).second) {
+            throw SnapshotError("Snapshot has invalid document id"s);
+        }
+    }
+}
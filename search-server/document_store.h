@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory_resource>
+#include <vector>
+#include <unordered_map>
+
+#include "document.h"
+#include "snapshot_format.h"
+
+/* Internal number of a document at the server. Ordinals are assigned densely in order of adding
+   and are not reused, so that postings of new documents always go after the existing ones */
+using DocumentOrdinal = int;
+const DocumentOrdinal NO_DOCUMENT = -1;
+
+/* Columnar storage of document attributes indexed by ordinal.
+   Removed documents keep their slots (tombstones) until Compact() */
+class DocumentStore {
+public:
+    class IdIterator;
+
+    explicit DocumentStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /* Document id must not be at the store */
+    DocumentOrdinal Add(int document_id, int rating, DocumentStatus status);
+    /* Marks the document as removed in O(1) */
+    void Remove(DocumentOrdinal ordinal);
+
+    bool IsRemoved(DocumentOrdinal ordinal) const {
+        return removed_[ordinal];
+    }
+
+    /* Returns ordinal of the document or NO_DOCUMENT */
+    DocumentOrdinal Find(int document_id) const;
+
+    int GetId(DocumentOrdinal ordinal) const {
+        return ids_[ordinal];
+    }
+    int GetRating(DocumentOrdinal ordinal) const {
+        return ratings_[ordinal];
+    }
+    DocumentStatus GetStatus(DocumentOrdinal ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    /* Number of documents at the store */
+    size_t GetSize() const;
+    /* Number of assigned ordinals, including ordinals of removed documents */
+    size_t GetOrdinalCount() const;
+
+    /* Drops slots of removed documents and renumbers the others keeping their order.
+       Returns new ordinal for every old one, NO_DOCUMENT for removed documents */
+    std::vector<DocumentOrdinal> Compact();
+
+    /* Ids of documents at the store in order of adding */
+    IdIterator begin() const;
+    IdIterator end() const;
+
+    std::pmr::memory_resource* GetMemoryResource() const;
+
+    /* Writes all columns including tombstones, so that ordinals are kept */
+    void Save(SnapshotWriter& writer) const;
+    /* Reads documents written by Save() into an empty store */
+    void Load(SnapshotReader& reader);
+
+private:
+    std::pmr::vector<int> ids_;
+    std::pmr::vector<int> ratings_;
+    std::pmr::vector<DocumentStatus> statuses_;
+    std::pmr::vector<bool> removed_;
+
+    std::pmr::unordered_map<int, DocumentOrdinal> ordinals_;
+};
+
+class DocumentStore::IdIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    IdIterator(const DocumentStore& store, DocumentOrdinal ordinal)
+        : store_(&store)
+        , ordinal_(ordinal) {
+        SkipRemoved();
+    }
+
+    reference operator*() const {
+        return store_->ids_[ordinal_];
+    }
+    pointer operator->() const {
+        return &store_->ids_[ordinal_];
+    }
+
+    IdIterator& operator++() {
+        ++ordinal_;
+        SkipRemoved();
+        return *this;
+    }
+    IdIterator operator++(int) {
+        IdIterator result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const IdIterator& other) const {
+        return ordinal_ == other.ordinal_;
+    }
+    bool operator!=(const IdIterator& other) const {
+        return ordinal_ != other.ordinal_;
+    }
+
+private:
+    const DocumentStore* store_;
+    DocumentOrdinal ordinal_;
+
+    void SkipRemoved() {
+        while (ordinal_ < static_cast<DocumentOrdinal>(store_->GetOrdinalCount()) && store_->IsRemoved(ordinal_)) {
+            ++ordinal_;
+        }
+    }
+};
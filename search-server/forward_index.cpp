@@ -0,0 +1,45 @@
+#include "forward_index.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+ForwardIndex::ForwardIndex(pmr::memory_resource* resource)
+    : documents_(resource) {
+}
+
+void ForwardIndex::Clear(size_t ordinal) {
+    if (ordinal < mapped_count_) {
+        return;
+    }
+    auto& term_freqs = documents_.GetMutable(ordinal - mapped_count_);
+    term_freqs.clear();
+    term_freqs.shrink_to_fit();
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    vector<uint64_t> offsets{0};
+    vector<TermFreq> term_freqs;
+    for (size_t ordinal = 0; ordinal < size(); ++ordinal) {
+        const auto document_term_freqs = (*this)[ordinal];
+        term_freqs.insert(term_freqs.end(), document_term_freqs.begin(), document_term_freqs.end());
+        offsets.push_back(term_freqs.size());
+    }
+    writer.WriteArray<uint64_t>(offsets);
+    writer.WriteArray<TermFreq>(term_freqs);
+}
+
+void ForwardIndex::Load(SnapshotReader& reader, shared_ptr<const MappedFile> file, size_t document_count) {
+    const auto offsets = reader.ReadArray<uint64_t>();
+    const auto term_freqs = reader.ReadArray<TermFreq>();
+    /* Offsets are checked, so that a view never leaves the records. Records are covered by the checksum */
+    if (offsets.size() != document_count + 1 || offsets[0] != 0 || offsets.back() != term_freqs.size()
+            || !is_sorted(offsets.begin(), offsets.end())) {
+        throw SnapshotError("Snapshot has inconsistent term frequencies"s);
+    }
+    mapped_offsets_ = offsets;
+    mapped_term_freqs_ = term_freqs;
+    mapped_count_ = document_count;
+    file_ = move(file);
+}
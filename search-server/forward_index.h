@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+
+#include "array_view.h"
+#include "cow_vector.h"
+#include "mapped_file.h"
+#include "snapshot_format.h"
+#include "term_dictionary.h"
+
+/* Frequency of a term at a document */
+struct TermFreq {
+    TermId term;
+    double term_freq;
+};
+
+/* Term frequencies of documents sorted by term id, indexed by document ordinal (forward index).
+   Documents of an opened snapshot are read in place from the mapped file, documents added later
+   are kept in a CowVector. So copies share all term frequencies, and opening a snapshot doesn't
+   copy them */
+class ForwardIndex {
+public:
+    explicit ForwardIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /* Number of documents, including removed ones */
+    size_t size() const {
+        return mapped_count_ + documents_.size();
+    }
+
+    ArrayView<TermFreq> operator[](size_t ordinal) const {
+        if (ordinal < mapped_count_) {
+            const uint64_t first = mapped_offsets_[ordinal];
+            return {mapped_term_freqs_.data() + first, static_cast<size_t>(mapped_offsets_[ordinal + 1] - first)};
+        }
+        return documents_[ordinal - mapped_count_];
+    }
+
+    /* Appends a document and returns its term frequencies to be filled in order of terms */
+    std::pmr::vector<TermFreq>& emplace_back() {
+        return documents_.emplace_back();
+    }
+
+    /* Frees term frequencies of a removed document. Term frequencies read from the file stay there,
+       a removed document is not accessed anyway */
+    void Clear(size_t ordinal);
+
+    std::pmr::memory_resource* GetMemoryResource() const {
+        return documents_.GetMemoryResource();
+    }
+
+    /* Writes term frequencies of all documents in CSR layout: offsets by ordinal and records */
+    void Save(SnapshotWriter& writer) const;
+    /* Reads term frequencies of document_count documents written by Save() into an empty index.
+       They refer to the file */
+    void Load(SnapshotReader& reader, std::shared_ptr<const MappedFile> file, size_t document_count);
+
+private:
+    ArrayView<uint64_t> mapped_offsets_;
+    ArrayView<TermFreq> mapped_term_freqs_;
+    size_t mapped_count_ = 0;
+    std::shared_ptr<const MappedFile> file_;
+
+    /* Documents after the mapped ones */
+    CowVector<std::pmr::vector<TermFreq>> documents_;
+};
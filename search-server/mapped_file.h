@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* Read-only memory mapping of a whole file (POSIX mmap). Pages are loaded on first access
+   and are shared through the page cache with other processes mapping the same file */
+class MappedFile {
+public:
+    /* Throws std::system_error, if the file can't be opened or mapped */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /* Data is aligned at least to page size */
+    const char* GetData() const {
+        return data_;
+    }
+    size_t GetSize() const {
+        return size_;
+    }
+
+    /* Hints the kernel, that the file will be read sequentially, so that it reads ahead aggressively */
+    void AdviseSequential() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "posting_index.h"
+
+using namespace std;
+
+namespace {
+
+/* Side buffer is merged, when it holds more than 1/MERGE_RATIO of main postings */
+const size_t MERGE_RATIO = 8;
+const size_t MIN_MERGE_SIZE = 1024;
+
+bool LessDocumentId(const PostingIndex::Posting& lhs, const PostingIndex::Posting& rhs) {
+    return lhs.document_id < rhs.document_id;
+}
+
+} // namespace
+
+PostingIndex::Segment::Segment(pmr::memory_resource* resource)
+    : storage{pmr::vector<size_t>(1, 0, resource),
+              pmr::vector<size_t>(1, 0, resource),
+              pmr::vector<int>(resource),
+              pmr::vector<double>(resource),
+              pmr::vector<uint16_t>(resource),
+              pmr::vector<size_t>(1, 0, resource),
+              pmr::vector<uint32_t>(resource),
+              pmr::vector<double>(resource)} {
+    UpdateViews();
+}
+
+void PostingIndex::Segment::UpdateViews() {
+    offsets = storage.offsets;
+    block_offsets = storage.block_offsets;
+    block_last_documents = storage.block_last_documents;
+    block_max_term_freqs = storage.block_max_term_freqs;
+    block_bits = storage.block_bits;
+    block_data_offsets = storage.block_data_offsets;
+    data = storage.data;
+    max_term_freqs = storage.max_term_freqs;
+}
+
+size_t PostingIndex::Segment::DecodeBlock(TermId term, size_t block, int* documents, uint32_t* counts) const {
+    const size_t first_block = block_offsets[term];
+    const size_t size = min(BLOCK_SIZE, offsets[term + 1] - offsets[term] - (block - first_block) * BLOCK_SIZE);
+    const int base = block == first_block ? -1 : block_last_documents[block - 1];
+    const uint32_t* words = data.data() + block_data_offsets[block];
+
+    if (size == BLOCK_SIZE) {
+        const uint32_t document_bits = block_bits[block] & 0xFF;
+        const uint32_t count_bits = block_bits[block] >> 8;
+        UnpackDeltaBlock(words, document_bits, static_cast<uint32_t>(base), reinterpret_cast<uint32_t*>(documents));
+        UnpackBlock(words + PACKED_LANE_COUNT * document_bits, count_bits, counts);
+        return size;
+    }
+
+    /* Short block: {document id delta, count} pairs */
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(words);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(data.data() + block_data_offsets[block + 1]);
+    int document_id = base;
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t delta = 0;
+        input = ReadVarint(input, end, delta);
+        if (input != nullptr) input = ReadVarint(input, end, counts[i]);
+        if (input == nullptr) {
+            /* Loaded segments are checked for it (see Load()) */
+            throw SnapshotError("Posting block is damaged"s);
+        }
+        document_id += static_cast<int>(delta);
+        documents[i] = document_id;
+    }
+    return size;
+}
+
+void PostingIndex::Segment::AppendTerm(const vector<Posting>& postings, const PostingIndex& index) {
+    auto& [offsets, block_offsets, block_last_documents, block_max_term_freqs, block_bits,
+           block_data_offsets, data, max_term_freqs] = storage;
+    offsets.push_back(offsets.back() + postings.size());
+    max_term_freqs.push_back(0.0);
+
+    uint32_t values[BLOCK_SIZE];
+    uint8_t bytes[BLOCK_SIZE * 10];
+    int base = -1;
+    for (size_t begin = 0; begin < postings.size(); begin += BLOCK_SIZE) {
+        const size_t end = min(begin + BLOCK_SIZE, postings.size());
+        double max_term_freq = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            max_term_freq = max(max_term_freq, index.GetTermFreq(postings[i].document_id, postings[i].count));
+        }
+
+        if (end - begin == BLOCK_SIZE) {
+            /* Document ids as D4 deltas, then counts */
+            for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+                const int previous = i < PACKED_LANE_COUNT ? base : postings[begin + i - PACKED_LANE_COUNT].document_id;
+                values[i] = static_cast<uint32_t>(postings[begin + i].document_id - previous);
+            }
+            const uint32_t document_bits = GetRequiredBits(values, BLOCK_SIZE);
+            data.resize(data.size() + PACKED_LANE_COUNT * document_bits);
+            PackBlock(values, document_bits, data.data() + data.size() - PACKED_LANE_COUNT * document_bits);
+
+            for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+                values[i] = postings[begin + i].count;
+            }
+            const uint32_t count_bits = GetRequiredBits(values, BLOCK_SIZE);
+            data.resize(data.size() + PACKED_LANE_COUNT * count_bits);
+            PackBlock(values, count_bits, data.data() + data.size() - PACKED_LANE_COUNT * count_bits);
+            block_bits.push_back(static_cast<uint16_t>(document_bits | count_bits << 8));
+        } else {
+            size_t size = 0;
+            int document_id = base;
+            for (size_t i = begin; i < end; ++i) {
+                size += WriteVarint(static_cast<uint32_t>(postings[i].document_id - document_id), bytes + size);
+                size += WriteVarint(postings[i].count, bytes + size);
+                document_id = postings[i].document_id;
+            }
+            const size_t word_count = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+            data.resize(data.size() + word_count, 0);
+            memcpy(data.data() + data.size() - word_count, bytes, size);
+            block_bits.push_back(0);
+        }
+
+        base = postings[end - 1].document_id;
+        block_last_documents.push_back(base);
+        block_max_term_freqs.push_back(max_term_freq);
+        block_data_offsets.push_back(data.size());
+        max_term_freqs.back() = max(max_term_freqs.back(), max_term_freq);
+    }
+    block_offsets.push_back(block_last_documents.size());
+}
+
+PostingIndex::PostingIndex(pmr::memory_resource* resource)
+    : pending_(resource)
+    , document_freqs_(resource)
+    , inverse_document_lengths_(resource)
+    , inverse_document_freqs_(resource) {
+    segment_ = MakeSegment();
+}
+
+pmr::memory_resource* PostingIndex::GetMemoryResource() const {
+    return pending_.get_allocator().resource();
+}
+
+shared_ptr<PostingIndex::Segment> PostingIndex::MakeSegment() const {
+    pmr::memory_resource* resource = GetMemoryResource();
+    const pmr::polymorphic_allocator<Segment> allocator(resource);
+    return allocate_shared<Segment>(allocator, resource);
+}
+
+size_t PostingIndex::GetTermCount() const {
+    return document_freqs_.size();
+}
+
+void PostingIndex::AddTerms(size_t term_count) {
+    pending_.resize(term_count);
+    document_freqs_.resize(term_count, 0);
+    inverse_document_freqs_.resize(term_count);
+}
+
+void PostingIndex::SetDocumentLength(int document_id, size_t word_count) {
+    if (static_cast<size_t>(document_id) >= inverse_document_lengths_.size()) {
+        inverse_document_lengths_.resize(document_id + 1, 0.0);
+    }
+    inverse_document_lengths_[document_id] = 1.0 / static_cast<double>(word_count);
+}
+
+void PostingIndex::AddPosting(TermId term, int document_id, uint32_t count) {
+    if (term >= GetTermCount()) {
+        AddTerms(term + 1);
+    }
+    auto& pending = pending_[term];
+    const Posting posting{document_id, count};
+    pending.insert(upper_bound(pending.begin(), pending.end(), posting, LessDocumentId), posting);
+    ++pending_count_;
+    ++document_freqs_[term];
+}
+
+void PostingIndex::DecrementDocumentFreq(TermId term) {
+    --document_freqs_[term];
+}
+
+int PostingIndex::GetDocumentFreq(TermId term) const {
+    return document_freqs_[term];
+}
+
+void PostingIndex::SetDocumentCount(int document_count) {
+    document_count_ = document_count;
+    ++generation_;
+}
+
+double PostingIndex::GetInverseDocumentFreq(TermId term) const {
+    CachedValue& cached = inverse_document_freqs_[term];
+    if (cached.generation.load(memory_order_acquire) == generation_) {
+        return cached.value.load(memory_order_relaxed);
+    }
+    /* Concurrent readers may compute the same value, it is stored before generation is published */
+    const double value = ComputeInverseDocumentFreq(document_count_, document_freqs_[term]);
+    cached.value.store(value, memory_order_relaxed);
+    cached.generation.store(generation_, memory_order_release);
+    return value;
+}
+
+double PostingIndex::ComputeInverseDocumentFreq(int document_count, int document_freq) {
+    return log(document_count * 1.0 / static_cast<double>(document_freq));
+}
+
+PostingIndex::TermStats PostingIndex::GetTermStats(TermId term) const {
+    if (document_freqs_[term] == 0) {
+        return {};
+    }
+    return {document_freqs_[term], GetInverseDocumentFreq(term)};
+}
+
+PostingIndex::CachedValue::CachedValue(const CachedValue& other)
+    : generation(other.generation.load())
+    , value(other.value.load()) {
+}
+
+PostingIndex::CachedValue& PostingIndex::CachedValue::operator=(const CachedValue& other) {
+    generation.store(other.generation.load());
+    value.store(other.value.load());
+    return *this;
+}
+
+vector<int> PostingIndex::SplitPostings(TermId term, size_t part_count) const {
+    /* Quantiles of the main blocks and the side buffer postings merged by document id.
+       Block is counted at once by its last document, so parts of the main segment begin
+       at block boundaries */
+    vector<int> result;
+    const Segment& segment = *segment_;
+    const size_t main_size = segment.GetEnd(term) - segment.GetBegin(term);
+    const size_t block_begin = segment.GetBlockBegin(term);
+    const size_t block_end = segment.GetBlockEnd(term);
+    const auto& pending = pending_[term];
+    const size_t size = main_size + pending.size();
+
+    size_t block = block_begin;
+    auto pending_it = pending.begin();
+    size_t count = 0;           /* postings up to the current one */
+    size_t part = 1;
+    while (part < part_count && count < size) {
+        int last_document_id;
+        if (block < block_end && (pending_it == pending.end()
+                                  || segment.block_last_documents[block] < pending_it->document_id)) {
+            last_document_id = segment.block_last_documents[block];
+            count += min(BLOCK_SIZE, main_size - (block - block_begin) * BLOCK_SIZE);
+            ++block;
+        } else {
+            last_document_id = pending_it->document_id;
+            ++count;
+            ++pending_it;
+        }
+        if (count < part * size / part_count || count == size) continue;
+        /* Next part begins after the current posting */
+        if (result.empty() || result.back() <= last_document_id) {
+            result.push_back(last_document_id + 1);
+        }
+        while (part < part_count && part * size / part_count <= count) {
+            ++part;
+        }
+    }
+    return result;
+}
+
+PostingIndex::Cursor PostingIndex::OpenCursor(TermId term) const {
+    return Cursor(*this, term);
+}
+
+void PostingIndex::MergeIfNeeded() {
+    if (pending_count_ > max(MIN_MERGE_SIZE, segment_->GetPostingCount() / MERGE_RATIO)) {
+        Merge();
+    }
+}
+
+void PostingIndex::Merge() {
+    Rebuild();
+}
+
+uint64_t PostingIndex::GetRebuiltPostingCount() const {
+    return rebuilt_posting_count_;
+}
+
+void PostingIndex::Compact(const vector<int>& new_documents) {
+    /* Document lengths follow new ids before the segment is encoded: they give term frequencies */
+    pmr::vector<double> inverse_document_lengths(inverse_document_lengths_.get_allocator());
+    for (size_t document_id = 0; document_id < inverse_document_lengths_.size(); ++document_id) {
+        if (document_id < new_documents.size() && new_documents[document_id] >= 0) {
+            inverse_document_lengths.push_back(inverse_document_lengths_[document_id]);
+        }
+    }
+    inverse_document_lengths_ = move(inverse_document_lengths);
+
+    Rebuild(&new_documents);
+    for (TermId term = 0; term < GetTermCount(); ++term) {
+        document_freqs_[term] = static_cast<int>(segment_->GetEnd(term) - segment_->GetBegin(term));
+    }
+    ++generation_;
+}
+
+void PostingIndex::AddPostings(const vector<TermPosting>& batch) {
+    if (batch.empty()) return;
+    if (batch.back().term >= GetTermCount()) {
+        AddTerms(batch.back().term + 1);
+    }
+    for (auto it = batch.begin(); it != batch.end();) {
+        const TermId term = it->term;
+        auto& pending = pending_[term];
+        const size_t old_size = pending.size();
+        for (; it != batch.end() && it->term == term; ++it) {
+            pending.push_back(it->posting);
+        }
+        /* New documents usually follow the buffered ones */
+        if (old_size > 0 && pending[old_size].document_id < pending[old_size - 1].document_id) {
+            inplace_merge(pending.begin(), pending.begin() + old_size, pending.end(), LessDocumentId);
+        }
+        document_freqs_[term] += static_cast<int>(pending.size() - old_size);
+    }
+    pending_count_ += batch.size();
+    MergeIfNeeded();
+}
+
+void PostingIndex::Rebuild(const vector<int>* new_documents) {
+    /* Old segment may be shared with other copies of the index, so a new one is built */
+    const Segment& old_segment = *segment_;
+    shared_ptr<Segment> segment = MakeSegment();
+    Segment::Storage& storage = segment->storage;
+    storage.offsets.reserve(GetTermCount() + 1);
+    storage.block_offsets.reserve(GetTermCount() + 1);
+    storage.max_term_freqs.reserve(GetTermCount());
+
+    vector<Posting> postings;
+    int documents[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (TermId term = 0; term < GetTermCount(); ++term) {
+        const auto& added = pending_[term];
+        auto added_it = added.begin();
+
+        /* Both sequences are sorted by document id */
+        postings.clear();
+        for (size_t block = old_segment.GetBlockBegin(term); block < old_segment.GetBlockEnd(term); ++block) {
+            const size_t size = old_segment.DecodeBlock(term, block, documents, counts);
+            for (size_t i = 0; i < size; ++i) {
+                while (added_it != added.end() && added_it->document_id < documents[i]) {
+                    postings.push_back(*added_it++);
+                }
+                postings.push_back({documents[i], counts[i]});
+            }
+        }
+        postings.insert(postings.end(), added_it, added.end());
+
+        if (new_documents != nullptr) {
+            size_t position = 0;
+            for (const Posting& posting : postings) {
+                const int document_id = posting.document_id < static_cast<int>(new_documents->size())
+                                        ? (*new_documents)[posting.document_id] : -1;
+                if (document_id >= 0) {
+                    postings[position++] = {document_id, posting.count};
+                }
+            }
+            postings.resize(position);
+        }
+        segment->AppendTerm(postings, *this);
+
+        pending_[term].clear();
+        pending_[term].shrink_to_fit();
+    }
+    segment->UpdateViews();
+    rebuilt_posting_count_ += segment->GetPostingCount();
+    segment_ = move(segment);
+    pending_count_ = 0;
+}
+
+void PostingIndex::Save(SnapshotWriter& writer) const {
+    /* Side buffer is merged at a copy, which shares the segment */
+    PostingIndex index(*this);
+    index.Merge();
+    const Segment& segment = *index.segment_;
+    writer.WriteArray<int>(document_freqs_);
+    writer.WriteArray<double>(inverse_document_lengths_);
+    writer.WriteArray(segment.offsets);
+    writer.WriteArray(segment.block_offsets);
+    writer.WriteArray(segment.block_last_documents);
+    writer.WriteArray(segment.block_max_term_freqs);
+    writer.WriteArray(segment.block_bits);
+    writer.WriteArray(segment.block_data_offsets);
+    writer.WriteArray(segment.data);
+    writer.WriteArray(segment.max_term_freqs);
+}
+
+void PostingIndex::Load(SnapshotReader& reader, shared_ptr<const MappedFile> file) {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "Snapshot stores offsets as 64-bit values");
+    const auto document_freqs = reader.ReadArray<int>();
+    const auto inverse_document_lengths = reader.ReadArray<double>();
+    shared_ptr<Segment> segment = MakeSegment();
+    segment->offsets = reader.ReadArray<size_t>();
+    segment->block_offsets = reader.ReadArray<size_t>();
+    segment->block_last_documents = reader.ReadArray<int>();
+    segment->block_max_term_freqs = reader.ReadArray<double>();
+    segment->block_bits = reader.ReadArray<uint16_t>();
+    segment->block_data_offsets = reader.ReadArray<size_t>();
+    segment->data = reader.ReadArray<uint32_t>();
+    segment->max_term_freqs = reader.ReadArray<double>();
+    segment->file = move(file);
+
+    /* Arrays must be consistent, so that decoding the segment stays in bounds */
+    const size_t term_count = document_freqs.size();
+    const size_t block_count = segment->block_last_documents.size();
+    const bool is_consistent = segment->offsets.size() == term_count + 1
+        && segment->block_offsets.size() == term_count + 1
+        && segment->max_term_freqs.size() == term_count
+        && segment->offsets[0] == 0 && segment->block_offsets[0] == 0
+        && segment->block_offsets.back() == block_count
+        && segment->block_max_term_freqs.size() == block_count
+        && segment->block_bits.size() == block_count
+        && segment->block_data_offsets.size() == block_count + 1
+        && segment->block_data_offsets[0] == 0 && segment->block_data_offsets.back() == segment->data.size()
+        && is_sorted(segment->offsets.begin(), segment->offsets.end())
+        && is_sorted(segment->block_data_offsets.begin(), segment->block_data_offsets.end());
+    if (!is_consistent) {
+        throw SnapshotError("Snapshot has inconsistent posting index"s);
+    }
+    for (TermId term = 0; term < term_count; ++term) {
+        const size_t size = segment->offsets[term + 1] - segment->offsets[term];
+        const size_t first_block = segment->block_offsets[term];
+        if (segment->block_offsets[term + 1] - first_block != (size + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+            throw SnapshotError("Snapshot has inconsistent posting index"s);
+        }
+        /* Full blocks must have exactly their packed words */
+        for (size_t block = first_block; block < first_block + size / BLOCK_SIZE; ++block) {
+            const uint32_t document_bits = segment->block_bits[block] & 0xFF;
+            const uint32_t count_bits = segment->block_bits[block] >> 8;
+            if (document_bits > 32 || count_bits > 32
+                    || segment->block_data_offsets[block + 1] - segment->block_data_offsets[block]
+                       != PACKED_LANE_COUNT * (document_bits + count_bits)) {
+                throw SnapshotError("Snapshot has inconsistent posting index"s);
+            }
+        }
+    }
+
+    AddTerms(term_count);
+    copy(document_freqs.begin(), document_freqs.end(), document_freqs_.begin());
+    inverse_document_lengths_.assign(inverse_document_lengths.begin(), inverse_document_lengths.end());
+    segment_ = move(segment);
+    ++generation_;
+}
+
+PostingIndex::Cursor::Cursor(const PostingIndex& index, TermId term)
+    : index_(&index)
+    , segment_(index.segment_.get())
+    , term_(term)
+    , block_end_(segment_->GetBlockEnd(term))
+    , bound_block_(segment_->GetBlockBegin(term))
+    , documents_(BLOCK_SIZE)
+    , counts_(BLOCK_SIZE) {
+    LoadBlock(segment_->GetBlockBegin(term));
+}
+
+void PostingIndex::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    size_ = block < block_end_ ? segment_->DecodeBlock(term_, block, documents_.data(), counts_.data()) : 0;
+}
+
+void PostingIndex::Cursor::Seek(int document_id) {
+    if (IsEnd() || GetDocumentId() >= document_id) {
+        return;
+    }
+    /* Skip whole blocks by their last document, then search inside the block */
+    if (documents_[size_ - 1] < document_id) {
+        const auto& block_last_documents = segment_->block_last_documents;
+        size_t block = block_ + 1;
+        while (block < block_end_ && block_last_documents[block] < document_id) {
+            ++block;
+        }
+        LoadBlock(block);
+        if (IsEnd()) return;
+    }
+    position_ = lower_bound(documents_.begin() + position_, documents_.begin() + size_, document_id) - documents_.begin();
+}
+
+PostingIndex::Cursor::BlockBound PostingIndex::Cursor::GetBlockBound(int document_id) {
+    const auto& block_last_documents = segment_->block_last_documents;
+    while (bound_block_ < block_end_ && block_last_documents[bound_block_] < document_id) {
+        ++bound_block_;
+    }
+    if (bound_block_ == block_end_) {
+        return {0.0, numeric_limits<int>::max()};
+    }
+    return {segment_->block_max_term_freqs[bound_block_], block_last_documents[bound_block_]};
+}
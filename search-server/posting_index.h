@@ -0,0 +1,314 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "array_view.h"
+#include "bit_packing.h"
+#include "mapped_file.h"
+#include "snapshot_format.h"
+#include "term_dictionary.h"
+
+/* Inverted index <term id, postings> with compressed posting lists.
+   Merged postings of all terms are kept in one segment, sorted by term and then by document id.
+   Postings of a term are split into blocks of BLOCK_SIZE postings. Full block stores document ids
+   as D4 deltas and counts of the term, both bit-packed (see bit_packing.h), the last (short) block
+   of a term is variable byte coded. Every block has skip data: id of its last document, maximal
+   term frequency and bit widths.
+   Term frequency isn't stored: it is count of the term / length of the document.
+   Postings of newly added documents go to a per-term side buffer, which is merged into
+   the main segment in bulk (see Merge()).
+   Main segment is shared between copies of the index and is copied only on write, so that
+   a copy of the index costs the size of the side buffer and per-term counters.
+   Main segment of a loaded snapshot is read in place from the mapped file.
+   Documents are identified by non-negative integers: SearchServer stores document ordinals. */
+class PostingIndex {
+public:
+    struct Posting {
+        int document_id;
+        uint32_t count;         /* number of occurrences of the term at the document */
+    };
+
+    static constexpr size_t BLOCK_SIZE = PACKED_BLOCK_SIZE;
+
+    class Cursor;
+
+    /* All index storage is allocated from the resource */
+    explicit PostingIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    struct TermStats {
+        int document_freq = 0;
+        double inverse_document_freq = 0.0;
+    };
+
+    struct TermPosting {
+        TermId term;
+        Posting posting;
+    };
+
+    /* Number of words of the document. Must be set before postings of the document are added */
+    void SetDocumentLength(int document_id, size_t word_count);
+    double GetTermFreq(int document_id, uint32_t count) const {
+        return count * inverse_document_lengths_[document_id];
+    }
+
+    /* Index grows automatically, when posting of a new term is added */
+    void AddPosting(TermId term, int document_id, uint32_t count);
+    /* Adds a batch of postings sorted by term and document id to the side buffer.
+       Batch must contain all postings of its documents. Side buffer is merged if needed */
+    void AddPostings(const std::vector<TermPosting>& batch);
+    /* Lazy removal: the document stops counting for the term, its posting stays until Compact().
+       Caller must skip such postings */
+    void DecrementDocumentFreq(TermId term);
+
+    /* Terms are 0 .. GetTermCount() - 1 */
+    size_t GetTermCount() const;
+    /* Number of documents containing the term */
+    int GetDocumentFreq(TermId term) const;
+
+    /* Number of documents at the index, which IDF is computed for.
+       Changing it invalidates all cached IDF values */
+    void SetDocumentCount(int document_count);
+
+    /* IDF of the term. It is computed once per document count change and cached.
+       Safe to call from concurrent readers */
+    double GetInverseDocumentFreq(TermId term) const;
+    static double ComputeInverseDocumentFreq(int document_count, int document_freq);
+    TermStats GetTermStats(TermId term) const;
+
+    /* Calls function(document_id, term_freq) for every posting of the term */
+    template <typename Function>
+    void ForEachPosting(TermId term, Function function) const;
+
+    /* Same for postings with document id from first_document_id to last_document_id inclusive */
+    template <typename Function>
+    void ForEachPosting(TermId term, int first_document_id, int last_document_id, Function function) const;
+
+    /* Document ids, which split postings of the term (main segment and side buffer together)
+       into parts of nearly equal size. Returns at most part_count - 1 ascending ids, each id is
+       the first of its part */
+    std::vector<int> SplitPostings(TermId term, size_t part_count) const;
+
+    /* Same for postings of the side buffer only */
+    template <typename Function>
+    void ForEachPendingPosting(TermId term, Function function) const;
+
+    /* Cursor over postings of the main segment only. Documents of the main segment and
+       the side buffer never intersect: all postings of a document are merged at once.
+       Cursor must not outlive the index */
+    Cursor OpenCursor(TermId term) const;
+
+    /* Merges side buffer if it grew big enough relative to the main segment.
+       Should be called between documents, so that all postings of a document are in one place. */
+    void MergeIfNeeded();
+    void Merge();
+    /* Number of postings written to main segments by merges and compactions. Merges are amortized,
+       so it stays within a constant factor of the number of added postings */
+    uint64_t GetRebuiltPostingCount() const;
+
+    /* Merges side buffer and renumbers documents: posting of document d gets id new_documents[d],
+       postings of documents with negative new id are dropped. Renumbering must keep order of documents */
+    void Compact(const std::vector<int>& new_documents);
+
+    /* Writes merged postings, skip data, document frequencies and lengths */
+    void Save(SnapshotWriter& writer) const;
+    /* Reads the index written by Save() into an empty index. Main segment refers to the file */
+    void Load(SnapshotReader& reader, std::shared_ptr<const MappedFile> file);
+
+private:
+    /* Main (merged) compressed postings with skip data. Segment covers terms, which existed
+       at the last merge, newer terms have no postings at it */
+    struct Segment {
+        /* Arrays of the segment. They refer to the storage below or to the mapped file */
+        /* Postings of term t are offsets[t] .. offsets[t + 1] */
+        ArrayView<size_t> offsets;
+        /* Blocks of term t are block_offsets[t] .. block_offsets[t + 1] */
+        ArrayView<size_t> block_offsets;
+
+        /* Skip data of blocks */
+        ArrayView<int> block_last_documents;
+        ArrayView<double> block_max_term_freqs;
+        ArrayView<uint16_t> block_bits;             /* bits of document deltas | bits of counts << 8 */
+        /* Words of block b are data[block_data_offsets[b] .. block_data_offsets[b + 1]) */
+        ArrayView<size_t> block_data_offsets;
+        ArrayView<uint32_t> data;
+
+        ArrayView<double> max_term_freqs;
+
+        /* Arrays of a segment built in memory. Changing them requires UpdateViews() */
+        struct Storage {
+            std::pmr::vector<size_t> offsets;
+            std::pmr::vector<size_t> block_offsets;
+            std::pmr::vector<int> block_last_documents;
+            std::pmr::vector<double> block_max_term_freqs;
+            std::pmr::vector<uint16_t> block_bits;
+            std::pmr::vector<size_t> block_data_offsets;
+            std::pmr::vector<uint32_t> data;
+            std::pmr::vector<double> max_term_freqs;
+        };
+        Storage storage;
+        /* Mapped file, which arrays of a loaded segment refer to */
+        std::shared_ptr<const MappedFile> file;
+
+        explicit Segment(std::pmr::memory_resource* resource);
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+
+        size_t GetTermCount() const {
+            return max_term_freqs.size();
+        }
+        size_t GetPostingCount() const {
+            return offsets.back();
+        }
+        size_t GetBegin(TermId term) const {
+            return term < GetTermCount() ? offsets[term] : GetPostingCount();
+        }
+        size_t GetEnd(TermId term) const {
+            return term < GetTermCount() ? offsets[term + 1] : GetPostingCount();
+        }
+        size_t GetBlockBegin(TermId term) const {
+            return term < GetTermCount() ? block_offsets[term] : block_last_documents.size();
+        }
+        size_t GetBlockEnd(TermId term) const {
+            return term < GetTermCount() ? block_offsets[term + 1] : block_last_documents.size();
+        }
+        double GetMaxTermFreq(TermId term) const {
+            return term < GetTermCount() ? max_term_freqs[term] : 0.0;
+        }
+
+        /* Decodes block of the term, returns number of its postings */
+        size_t DecodeBlock(TermId term, size_t block, int* documents, uint32_t* counts) const;
+        /* Encodes postings of the next term to the storage, sorted by document id. Views aren't updated */
+        void AppendTerm(const std::vector<Posting>& postings, const PostingIndex& index);
+        void UpdateViews();
+    };
+    std::shared_ptr<Segment> segment_;
+
+    /* Side buffer with postings of recently added documents, sorted by document id */
+    std::pmr::vector<std::pmr::vector<Posting>> pending_;
+    size_t pending_count_ = 0;
+    uint64_t rebuilt_posting_count_ = 0;
+
+    std::pmr::vector<int> document_freqs_;
+    /* 1 / number of words of the document, by document id */
+    std::pmr::vector<double> inverse_document_lengths_;
+
+    /* Cached IDF. Value is valid, if its generation is equal to generation_ */
+    struct CachedValue {
+        std::atomic<uint64_t> generation{0};
+        std::atomic<double> value{0.0};
+
+        CachedValue() = default;
+        CachedValue(const CachedValue& other);
+        CachedValue& operator=(const CachedValue& other);
+    };
+    mutable std::pmr::vector<CachedValue> inverse_document_freqs_;
+    uint64_t generation_ = 1;
+    int document_count_ = 0;
+
+    void AddTerms(size_t term_count);
+    /* Builds new segment from the old one and the side buffer.
+       Documents are renumbered by new_documents, if it isn't nullptr (see Compact()) */
+    void Rebuild(const std::vector<int>* new_documents = nullptr);
+
+    std::pmr::memory_resource* GetMemoryResource() const;
+    std::shared_ptr<Segment> MakeSegment() const;
+};
+
+/* Document-at-a-time iteration over postings of one term in the main segment.
+   Postings are visited by ascending document id, the current block is decoded at once */
+class PostingIndex::Cursor {
+public:
+    Cursor(const PostingIndex& index, TermId term);
+
+    bool IsEnd() const {
+        return position_ == size_;
+    }
+    int GetDocumentId() const {
+        return documents_[position_];
+    }
+    double GetTermFreq() const {
+        return index_->GetTermFreq(documents_[position_], counts_[position_]);
+    }
+    /* Upper bound of term frequency for all postings of the term */
+    double GetMaxTermFreq() const {
+        return segment_->GetMaxTermFreq(term_);
+    }
+
+    void Next() {
+        if (++position_ == size_) {
+            LoadBlock(block_ + 1);
+        }
+    }
+    /* Moves to the first posting with id not less than document_id */
+    void Seek(int document_id);
+
+    struct BlockBound {
+        double max_term_freq;
+        int last_document_id;
+    };
+    /* Skip data of the block, that could contain document_id. Doesn't move the cursor.
+       Returns {0, INT_MAX} if there is no postings with id not less than document_id.
+       document_id must not decrease between calls */
+    BlockBound GetBlockBound(int document_id);
+
+private:
+    const PostingIndex* index_;
+    const Segment* segment_;
+    TermId term_;
+    size_t block_;
+    size_t block_end_;
+    size_t bound_block_;
+
+    /* Decoded postings of the current block. Vectors are cheap to move, cursors are sorted */
+    std::vector<int> documents_;
+    std::vector<uint32_t> counts_;
+    size_t size_ = 0;
+    size_t position_ = 0;
+
+    void LoadBlock(size_t block);
+};
+
+template <typename Function>
+inline void PostingIndex::ForEachPosting(TermId term, Function function) const {
+    ForEachPosting(term, 0, std::numeric_limits<int>::max(), function);
+}
+
+template <typename Function>
+inline void PostingIndex::ForEachPosting(TermId term, int first_document_id, int last_document_id, Function function) const {
+    // main segment: find the first block by skip data, then decode blocks one by one
+    const Segment& segment = *segment_;
+    const auto first_block = segment.block_last_documents.begin() + segment.GetBlockBegin(term);
+    const auto last_block = segment.block_last_documents.begin() + segment.GetBlockEnd(term);
+    int documents[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (auto block = std::lower_bound(first_block, last_block, first_document_id); block != last_block; ++block) {
+        const size_t size = segment.DecodeBlock(term, block - segment.block_last_documents.begin(), documents, counts);
+        for (size_t i = std::lower_bound(documents, documents + size, first_document_id) - documents;
+             i < size && documents[i] <= last_document_id; ++i) {
+            function(documents[i], GetTermFreq(documents[i], counts[i]));
+        }
+        if (*block >= last_document_id) break;
+    }
+
+    // side buffer
+    const auto less_document_id = [](const Posting& posting, int document_id) {
+        return posting.document_id < document_id; };
+    const auto& pending = pending_[term];
+    for (auto it = std::lower_bound(pending.begin(), pending.end(), first_document_id, less_document_id);
+         it != pending.end() && it->document_id <= last_document_id; ++it) {
+        function(it->document_id, GetTermFreq(it->document_id, it->count));
+    }
+}
+
+template <typename Function>
+inline void PostingIndex::ForEachPendingPosting(TermId term, Function function) const {
+    for (const Posting& posting : pending_[term]) {
+        function(posting.document_id, GetTermFreq(posting.document_id, posting.count));
+    }
+}
@@ -6,25 +6,65 @@
 
 using namespace std;
 
-vector<vector<Document>> ProcessQueries(const SearchServer &search_server, const vector<string> &queries) {
+namespace {
+
+/* Searcher is SearchServer or QueryCache */
+template <typename Searcher>
+vector<vector<Document>> ProcessQueriesWith(Searcher& searcher, const vector<string> &queries, QueryExecutor* executor) {
     
     vector<vector<Document>> documents_lists(queries.size());
 
+    if (executor != nullptr) {
+        executor->ParallelFor(queries.size(), [&](size_t i) {
+            documents_lists[i] = searcher.FindTopDocuments(queries[i]);
+        });
+        return documents_lists;
+    }
+
     transform(execution::par, 
               queries.begin(), 
               queries.end(), 
               documents_lists.begin(), 
-              [&search_server](const string& query){ return search_server.FindTopDocuments(query);});
+              [&searcher](const string& query){ return searcher.FindTopDocuments(query);});
 
     return documents_lists;
 }
 
-vector<Document> ProcessQueriesJoined(const SearchServer &search_server, const vector<string> &queries) {
+vector<Document> Join(const vector<vector<Document>>& documents_lists) {
     vector<Document> result;
-    for (const auto& documents_list : ProcessQueries(search_server, queries)) {
+    for (const auto& documents_list : documents_lists) {
         for (const auto& document : documents_list) {
             result.push_back(document);
         }
     }
     return result;
-}
\ No newline at end of file
+}
+
+} // namespace
+
+vector<vector<Document>> ProcessQueries(const SearchServer &search_server, const vector<string> &queries,
+                                        QueryExecutor* executor) {
+    return ProcessQueriesWith(search_server, queries, executor);
+}
+
+vector<Document> ProcessQueriesJoined(const SearchServer &search_server, const vector<string> &queries,
+                                      QueryExecutor* executor) {
+    return Join(ProcessQueries(search_server, queries, executor));
+}
+
+vector<vector<Document>> ProcessQueries(QueryCache& query_cache, const vector<string>& queries,
+                                        QueryExecutor* executor) {
+    return ProcessQueriesWith(query_cache, queries, executor);
+}
+
+vector<Document> ProcessQueriesJoined(QueryCache& query_cache, const vector<string>& queries,
+                                      QueryExecutor* executor) {
+    return Join(ProcessQueries(query_cache, queries, executor));
+}
+vector<vector<Document>> ProcessQueriesBatch(const SearchServer& search_server, const vector<string>& queries) {
+    return search_server.FindTopDocumentsBatch(queries);
+}
+
+vector<Document> ProcessQueriesBatchJoined(const SearchServer& search_server, const vector<string>& queries) {
+    return Join(ProcessQueriesBatch(search_server, queries));
+}
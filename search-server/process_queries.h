@@ -3,15 +3,41 @@
 #include <vector>
 
 #include "document.h"
+#include "query_cache.h"
+#include "query_executor.h"
 #include "search_server.h"
 
 /* Принимает N запросов и возвращает вектор длины N, 
-   i-й элемент которого — результат вызова FindTopDocuments для i-го запроса. */
+   i-й элемент которого — результат вызова FindTopDocuments для i-го запроса.
+   Если передан executor, запросы выполняются на его потоках, иначе — через execution::par */
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries); 
+    const std::vector<std::string>& queries,
+    QueryExecutor* executor = nullptr); 
 
 /* Возвращает набор документов в плоском виде */
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server, 
+    const std::vector<std::string>& queries,
+    QueryExecutor* executor = nullptr);
+
+/* То же через кеш результатов: повторяющиеся запросы не выполняются заново */
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries,
+    QueryExecutor* executor = nullptr);
+
+std::vector<Document> ProcessQueriesJoined(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries,
+    QueryExecutor* executor = nullptr);
+
+/* То же одним пакетом (SearchServer::FindTopDocumentsBatch): список документов каждого слова,
+   общего для нескольких запросов, обходится один раз для всего пакета */
+std::vector<std::vector<Document>> ProcessQueriesBatch(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesBatchJoined(
+    const SearchServer& search_server,
     const std::vector<std::string>& queries);
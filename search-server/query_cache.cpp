@@ -0,0 +1,119 @@
+#include "query_cache.h"
+
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+QueryCache::QueryCache(const SearchServer& search_server, size_t capacity, size_t shard_count)
+    : search_server_(search_server)
+    , shards_(shard_count)
+{
+    if (capacity == 0 || shard_count == 0) {
+        throw invalid_argument("Capacity and shard count of the cache must be positive"s);
+    }
+    shard_capacity_ = (capacity + shard_count - 1) / shard_count;
+}
+
+vector<Document> QueryCache::FindTopDocuments(string_view raw_query, DocumentStatus status) {
+    return FindOrSearch(raw_query, status, [this](string_view raw_query, DocumentStatus status) {
+        return search_server_.FindTopDocuments(raw_query, status);
+    });
+}
+
+vector<Document> QueryCache::FindTopDocuments(string_view raw_query) {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    stats.evictions = evictions_.load(memory_order_relaxed);
+    return stats;
+}
+
+size_t QueryCache::GetSize() const {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        size += shard.entries.size();
+    }
+    return size;
+}
+
+void QueryCache::Clear() {
+    for (Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        shard.positions.clear();
+        shard.entries.clear();
+    }
+}
+
+string QueryCache::MakeKey(string_view raw_query, DocumentStatus status) const {
+    SearchServer::QueryWords query_words = search_server_.ParseQueryWords(raw_query);
+    SearchServer::RemoveDuplicateWords(query_words);
+
+    /* Words have no spaces and control characters, and plus words don't start with '-',
+       so that the key is unambiguous */
+    string key;
+    for (const string_view word : query_words.plus_words) {
+        key += word;
+        key += ' ';
+    }
+    for (const string_view word : query_words.minus_words) {
+        key += '-';
+        key += word;
+        key += ' ';
+    }
+    key += '\t';
+    key += to_string(static_cast<int>(status));
+    key += '\t';
+    key += to_string(search_server_.GetMaxResultDocumentCount());
+    return key;
+}
+
+QueryCache::Shard& QueryCache::GetShard(string_view key) {
+    return shards_[hash<string_view>{}(key) % shards_.size()];
+}
+
+bool QueryCache::Find(const string& key, uint64_t generation, vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto position = shard.positions.find(key);
+    if (position == shard.positions.end()) {
+        return false;
+    }
+    const auto entry = position->second;
+    if (entry->generation != generation) {
+        /* Result of older generation will never be valid again */
+        shard.positions.erase(position);
+        shard.entries.erase(entry);
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    documents = entry->documents;
+    return true;
+}
+
+void QueryCache::Insert(string key, uint64_t generation, const vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto position = shard.positions.find(key);
+    if (position != shard.positions.end()) {
+        // result was stored by a concurrent miss of the same query
+        const auto entry = position->second;
+        entry->generation = generation;
+        entry->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+        return;
+    }
+
+    shard.entries.push_front({move(key), generation, documents});
+    shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+    if (shard.entries.size() > shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        evictions_.fetch_add(1, memory_order_relaxed);
+    }
+}
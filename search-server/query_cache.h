@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrent_map.h"
+#include "document.h"
+#include "search_server.h"
+
+/* Default number of cached results */
+const size_t QUERY_CACHE_CAPACITY = 10000;
+/* Default number of independently locked parts of the cache */
+const size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+/* Thread safe LRU cache of FindTopDocuments results in front of a server.
+   Key is the parsed query (sorted unique plus and minus words without stop words),
+   the status and the number of returned documents. Every result remembers generation
+   of the server (SearchServer::GetGeneration()), results of older generations are
+   treated as missing, so adding or removing documents invalidates the whole cache at once.
+   Cache is split into shards by hash of the key, every shard has its own lock and LRU list.
+   Queries with a predicate can't be compared, they bypass the cache.
+   Server must not be changed concurrently with queries, as without the cache */
+class QueryCache {
+public:
+    explicit QueryCache(const SearchServer& search_server, size_t capacity = QUERY_CACHE_CAPACITY,
+                        size_t shard_count = QUERY_CACHE_SHARD_COUNT);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status);
+    std::vector<Document> FindTopDocuments(std::string_view raw_query);
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status);
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate);
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;     /* results dropped to free space for new ones */
+    };
+    Stats GetStats() const;
+
+    size_t GetSize() const;
+    void Clear();
+
+    const SearchServer& GetSearchServer() const {
+        return search_server_;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex mutex;
+        /* Most recently used entries first */
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> positions;     /* keys refer to entries */
+    };
+
+    const SearchServer& search_server_;
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    std::string MakeKey(std::string_view raw_query, DocumentStatus status) const;
+    Shard& GetShard(std::string_view key);
+
+    /* Returns true and copies the result to documents, if the key has result of the current generation */
+    bool Find(const std::string& key, uint64_t generation, std::vector<Document>& documents);
+    void Insert(std::string key, uint64_t generation, const std::vector<Document>& documents);
+
+    /* Finds the result in the cache or computes it by search(raw_query, status) and stores it */
+    template <typename Search>
+    std::vector<Document> FindOrSearch(std::string_view raw_query, DocumentStatus status, Search search);
+};
+
+template <typename ExecutionPolicy>
+inline std::vector<Document> QueryCache::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
+                                                          DocumentStatus status) {
+    return FindOrSearch(raw_query, status, [this, policy](std::string_view raw_query, DocumentStatus status) {
+        return search_server_.FindTopDocuments(policy, raw_query, status);
+    });
+}
+
+template <typename ExecutionPolicy>
+inline std::vector<Document> QueryCache::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+inline std::vector<Document> QueryCache::FindTopDocuments(std::string_view raw_query,
+                                                          DocumentPredicate document_predicate) {
+    return search_server_.FindTopDocuments(raw_query, document_predicate);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+inline std::vector<Document> QueryCache::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
+                                                          DocumentPredicate document_predicate) {
+    return search_server_.FindTopDocuments(policy, raw_query, document_predicate);
+}
+
+template <typename Search>
+inline std::vector<Document> QueryCache::FindOrSearch(std::string_view raw_query, DocumentStatus status, Search search) {
+    /* Parsing throws for invalid query, the same way as the search */
+    std::string key = MakeKey(raw_query, status);
+    const uint64_t generation = search_server_.GetGeneration();
+    std::vector<Document> documents;
+    if (Find(key, generation, documents)) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return documents;
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    /* Search runs without lock: concurrent misses of the same query compute the same result */
+    documents = search(raw_query, status);
+    Insert(std::move(key), generation, documents);
+    return documents;
+}
@@ -0,0 +1,140 @@
+#include "query_executor.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+/* Executor and queue of the current worker thread */
+thread_local const QueryExecutor* current_executor = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+QueryExecutor::QueryExecutor(size_t thread_count)
+    : queues_(max<size_t>(thread_count, 1)) {
+    const size_t worker_count = queues_.size() - 1;
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        lock_guard guard(sleep_mutex_);
+        is_stopped_ = true;
+    }
+    wake_up_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void QueryExecutor::Run(const shared_ptr<Job>& job) {
+    // announce the job to idle workers: one helper per worker, who could join it
+    const size_t helper_count = min(job->count - 1, workers_.size());
+    if (helper_count > 0) {
+        Schedule(job, helper_count);
+    }
+
+    RunJob(*job);
+    // indices taken by other threads may still run, the last of them wakes the caller
+    unique_lock lock(job->mutex);
+    job->all_finished.wait(lock, [&job]() {
+        return job->finished_count.load(memory_order_acquire) == job->count;
+    });
+    if (job->error) {
+        rethrow_exception(job->error);
+    }
+}
+
+void QueryExecutor::Schedule(const shared_ptr<Job>& job, size_t task_count) {
+    TaskQueue& queue = queues_[GetQueueOfThisThread()];
+    pending_count_.fetch_add(task_count);
+    {
+        lock_guard guard(queue.mutex);
+        queue.tasks.insert(queue.tasks.end(), task_count, job);
+    }
+    {
+        lock_guard guard(sleep_mutex_);
+    }
+    if (task_count == 1) {
+        wake_up_.notify_one();
+    } else {
+        wake_up_.notify_all();
+    }
+}
+
+void QueryExecutor::RunPosted(const shared_ptr<Job>& job) {
+    if (workers_.empty()) {
+        RunJob(*job);
+    } else {
+        Schedule(job, 1);
+    }
+}
+
+void QueryExecutor::RunJob(Job& job) {
+    for (size_t index; (index = job.next_index.fetch_add(1, memory_order_relaxed)) < job.count;) {
+        if (!job.is_failed.load(memory_order_relaxed)) {
+            try {
+                job.call(job.function, index);
+            } catch (...) {
+                lock_guard guard(job.mutex);
+                if (!job.error) {
+                    job.error = current_exception();
+                }
+                job.is_failed.store(true, memory_order_relaxed);
+            }
+        }
+        if (job.finished_count.fetch_add(1, memory_order_acq_rel) + 1 == job.count) {
+            // under the lock: the caller either sees the count or already waits
+            lock_guard guard(job.mutex);
+            job.all_finished.notify_all();
+        }
+    }
+}
+
+bool QueryExecutor::RunPendingTask() {
+    if (pending_count_.load(memory_order_relaxed) == 0) {
+        return false;
+    }
+    const size_t own_queue = GetQueueOfThisThread();
+    shared_ptr<Job> task;
+    // own deque from the back, then other queues from the front
+    for (size_t i = 0; i < queues_.size() && !task; ++i) {
+        TaskQueue& queue = queues_[(own_queue + i) % queues_.size()];
+        lock_guard guard(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (i == 0) {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    pending_count_.fetch_sub(1);
+    RunJob(*task);
+    return true;
+}
+
+size_t QueryExecutor::GetQueueOfThisThread() const {
+    return current_executor == this ? current_queue : queues_.size() - 1;
+}
+
+void QueryExecutor::WorkerLoop(size_t index) {
+    current_executor = this;
+    current_queue = index;
+    for (;;) {
+        if (RunPendingTask()) continue;
+        unique_lock lock(sleep_mutex_);
+        wake_up_.wait(lock, [this]() { return is_stopped_ || pending_count_.load() > 0; });
+        // posted tasks are finished before stopping
+        if (is_stopped_ && pending_count_.load() == 0) return;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrent_map.h"
+
+/* Fixed pool of threads for parallel query processing.
+   ParallelFor(count, function) is a job: its indices are taken one by one by the threads working
+   on it, so that uneven tasks are balanced dynamically. Job is announced by helper tasks pushed
+   to the deque of the calling worker (or to the shared queue, if the caller isn't a worker).
+   Worker takes tasks from the back of its own deque and steals from the front of other deques.
+   Caller works on its job until all indices are taken, then sleeps until the indices taken by other
+   threads are finished. It doesn't run other tasks meanwhile, so its wait doesn't depend on them.
+   ParallelFor can be called from tasks of the same executor (e.g. parallel search inside
+   ProcessQueries): nested jobs run on the same threads without creating new ones, the caller of
+   a nested job always takes its indices itself */
+class QueryExecutor {
+public:
+    /* Caller of ParallelFor is one of the threads: thread_count - 1 workers are started */
+    explicit QueryExecutor(size_t thread_count = std::thread::hardware_concurrency());
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    size_t GetThreadCount() const {
+        return workers_.size() + 1;
+    }
+
+    /* Calls function(i) for i from 0 to count - 1 and returns, when all calls are finished.
+       If calls throw, the first exception is rethrown, calls not started yet are skipped */
+    template <typename Function>
+    void ParallelFor(size_t count, Function function);
+
+    /* Runs function() at a worker without waiting for it (at the caller, if there are no workers).
+       Exceptions of the function are lost. Posted tasks are finished before the executor is destroyed */
+    template <typename Function>
+    void Post(Function function);
+
+private:
+    struct Job {
+        size_t count = 0;
+        void (*call)(void* function, size_t index) = nullptr;
+        void* function = nullptr;
+        /* Owns the function of a posted job */
+        std::shared_ptr<void> owner;
+        std::atomic<size_t> next_index{0};
+        std::atomic<size_t> finished_count{0};
+        std::atomic<bool> is_failed{false};
+        /* Guards error and the wait for the last index */
+        std::mutex mutex;
+        std::condition_variable all_finished;
+        std::exception_ptr error;
+    };
+
+    /* Tasks are helpers of jobs. Job is shared by its helpers, some of them may outlive ParallelFor */
+    struct alignas(CACHE_LINE_SIZE) TaskQueue {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Job>> tasks;
+    };
+
+    /* Deques of workers and the shared queue of other threads (the last one) */
+    std::vector<TaskQueue> queues_;
+    std::vector<std::thread> workers_;
+
+    /* Number of tasks at the queues. It is increased before a task is pushed */
+    std::atomic<size_t> pending_count_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool is_stopped_ = false;
+
+    void Run(const std::shared_ptr<Job>& job);
+    /* Pushes task_count helper tasks of the job to the queue of this thread */
+    void Schedule(const std::shared_ptr<Job>& job, size_t task_count);
+    void RunPosted(const std::shared_ptr<Job>& job);
+    static void RunJob(Job& job);
+    /* Runs one task of the queues, returns false if there were none */
+    bool RunPendingTask();
+    size_t GetQueueOfThisThread() const;
+    void WorkerLoop(size_t index);
+};
+
+template <typename Function>
+inline void QueryExecutor::ParallelFor(size_t count, Function function) {
+    if (count == 0) return;
+    auto job = std::make_shared<Job>();
+    job->count = count;
+    job->function = &function;
+    job->call = [](void* function, size_t index) {
+        (*static_cast<Function*>(function))(index);
+    };
+    Run(job);
+}
+
+template <typename Function>
+inline void QueryExecutor::Post(Function function) {
+    auto owner = std::make_shared<Function>(std::move(function));
+    auto job = std::make_shared<Job>();
+    job->count = 1;
+    job->function = owner.get();
+    job->call = [](void* function, size_t) {
+        (*static_cast<Function*>(function))();
+    };
+    job->owner = std::move(owner);
+    RunPosted(job);
+}
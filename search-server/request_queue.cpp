@@ -1,22 +1,204 @@
 #include "request_queue.h"
 
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server) : search_server_(search_server) {
+RequestQueue::RequestQueue(const SearchServer& search_server, chrono::minutes window, Clock clock)
+    : search_server_(search_server)
+    , clock_(move(clock))
+    , window_(window.count())
+{
+    if (window_ <= 0) {
+        throw invalid_argument("Window of requests must be at least a minute"s);
+    }
+}
+
+RequestQueue::RequestQueue(QueryCache& query_cache, chrono::minutes window, Clock clock)
+    : RequestQueue(query_cache.GetSearchServer(), window, move(clock)) {
+    query_cache_ = &query_cache;
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-    return AddFindRequest( raw_query
-                         , [status](int document_id, DocumentStatus document_status, int rating) {
-                                [document_id](){};
-                                [rating](){};
-                                return document_status == status;});
+    const auto start = chrono::steady_clock::now();
+    auto search_results = query_cache_ != nullptr ? query_cache_->FindTopDocuments(raw_query, status)
+                                                  : search_server_.FindTopDocuments(raw_query, status);
+    AddRequest(search_results.empty(), chrono::steady_clock::now() - start);
+    return search_results;
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
+void RequestQueue::AddRequest(bool is_no_result, chrono::steady_clock::duration latency) {
+    const int64_t minute = GetCurrentMinute();
+    if (current_minute_.load(memory_order_acquire) < minute) {
+        lock_guard guard(window_mutex_);
+        StartMinute(minute);
+    }
+    /* A request of the previous minute, which comes after the new minute is started, is counted
+       in the new one. Requests being added while the minute is finished may get there too */
+
+    /* Threads are spread over stripes, so that they don't write to the same cache line */
+    thread_local const size_t stripe_index = hash<thread::id>{}(this_thread::get_id()) % STRIPE_COUNT;
+    Stripe& stripe = stripes_[stripe_index];
+    stripe.request_count.fetch_add(1, memory_order_relaxed);
+    if (is_no_result) {
+        stripe.no_result_count.fetch_add(1, memory_order_relaxed);
+    }
+    const auto microseconds = chrono::duration_cast<chrono::microseconds>(latency).count();
+    stripe.latency_buckets[GetLatencyBucket(microseconds > 0 ? static_cast<uint64_t>(microseconds) : 0)]
+        .fetch_add(1, memory_order_relaxed);
+}
+
 int RequestQueue::GetNoResultRequests() const {
-    return number_of_no_result_requests_;
-}
\ No newline at end of file
+    return static_cast<int>(GetWindowCounts().no_result_count);
+}
+
+uint64_t RequestQueue::GetRequestCount() const {
+    return GetWindowCounts().request_count;
+}
+
+RequestQueue::LatencyStats RequestQueue::GetLatencyStats() const {
+    const auto histogram = GetWindowCounts().latency_buckets;
+    LatencyStats stats;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        stats.request_count += histogram[bucket];
+        if (histogram[bucket] > 0) {
+            stats.max = chrono::microseconds(GetLatencyBucketUpperBound(bucket));
+        }
+    }
+    stats.p50 = GetPercentile(histogram, stats.request_count, 0.5);
+    stats.p99 = GetPercentile(histogram, stats.request_count, 0.99);
+    stats.p999 = GetPercentile(histogram, stats.request_count, 0.999);
+    return stats;
+}
+
+chrono::microseconds RequestQueue::GetLatencyPercentile(double share) const {
+    const auto histogram = GetWindowCounts().latency_buckets;
+    uint64_t count = 0;
+    for (const uint64_t bucket_count : histogram) {
+        count += bucket_count;
+    }
+    return GetPercentile(histogram, count, share);
+}
+
+int64_t RequestQueue::GetCurrentMinute() const {
+    return chrono::duration_cast<chrono::minutes>(clock_().time_since_epoch()).count();
+}
+
+void RequestQueue::WindowCounts::Add(const MinuteCounts& counts) {
+    request_count += counts.request_count;
+    no_result_count += counts.no_result_count;
+    for (const auto& [bucket, count] : counts.latency_buckets) {
+        latency_buckets[bucket] += count;
+    }
+}
+
+void RequestQueue::WindowCounts::Subtract(const MinuteCounts& counts) {
+    request_count -= counts.request_count;
+    no_result_count -= counts.no_result_count;
+    for (const auto& [bucket, count] : counts.latency_buckets) {
+        latency_buckets[bucket] -= count;
+    }
+}
+
+void RequestQueue::StartMinute(int64_t minute) {
+    const int64_t finished_minute = current_minute_.load(memory_order_relaxed);
+    if (finished_minute >= minute) {
+        /* Another writer has started it */
+        return;
+    }
+    /* Counters are taken by exchange, so that concurrent requests aren't lost */
+    MinuteCounts counts;
+    counts.minute = finished_minute;
+    array<uint64_t, LATENCY_BUCKET_COUNT> latency_buckets{};
+    for (Stripe& stripe : stripes_) {
+        counts.request_count += stripe.request_count.exchange(0, memory_order_relaxed);
+        counts.no_result_count += stripe.no_result_count.exchange(0, memory_order_relaxed);
+        for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+            latency_buckets[bucket] += stripe.latency_buckets[bucket].exchange(0, memory_order_relaxed);
+        }
+    }
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        if (latency_buckets[bucket] > 0) {
+            counts.latency_buckets.push_back({static_cast<uint16_t>(bucket), static_cast<uint32_t>(latency_buckets[bucket])});
+        }
+    }
+    if (counts.request_count > 0) {
+        finished_counts_.Add(counts);
+        finished_minutes_.push_back(move(counts));
+    }
+
+    const int64_t first_minute = minute - window_ + 1;
+    while (!finished_minutes_.empty() && finished_minutes_.front().minute < first_minute) {
+        finished_counts_.Subtract(finished_minutes_.front());
+        finished_minutes_.pop_front();
+    }
+    current_minute_.store(minute, memory_order_release);
+}
+
+RequestQueue::WindowCounts RequestQueue::GetWindowCounts() const {
+    const int64_t current_minute = GetCurrentMinute();
+    const int64_t first_minute = current_minute - window_ + 1;
+    lock_guard guard(window_mutex_);
+    WindowCounts counts = finished_counts_;
+    /* Minutes, which left the window while there were no requests, are still in the sums */
+    for (const MinuteCounts& minute_counts : finished_minutes_) {
+        if (minute_counts.minute >= first_minute) break;
+        counts.Subtract(minute_counts);
+    }
+    const int64_t stripes_minute = current_minute_.load(memory_order_acquire);
+    if (stripes_minute >= first_minute && stripes_minute <= current_minute) {
+        for (const Stripe& stripe : stripes_) {
+            counts.request_count += stripe.request_count.load(memory_order_relaxed);
+            counts.no_result_count += stripe.no_result_count.load(memory_order_relaxed);
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                counts.latency_buckets[bucket] += stripe.latency_buckets[bucket].load(memory_order_relaxed);
+            }
+        }
+    }
+    return counts;
+}
+
+size_t RequestQueue::GetLatencyBucket(uint64_t microseconds) {
+    const uint64_t value = min<uint64_t>(microseconds, numeric_limits<uint32_t>::max());
+    if (value < LATENCY_SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    /* Range [2^e, 2^(e+1)) is split into LATENCY_SUB_BUCKET_COUNT equal buckets */
+    const uint32_t exponent = 63 - __builtin_clzll(value);
+    const uint32_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    const size_t sub_bucket = static_cast<size_t>(value >> shift) & (LATENCY_SUB_BUCKET_COUNT - 1);
+    return (shift + 1) * LATENCY_SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t RequestQueue::GetLatencyBucketUpperBound(size_t bucket) {
+    if (bucket < LATENCY_SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const uint32_t shift = static_cast<uint32_t>(bucket / LATENCY_SUB_BUCKET_COUNT) - 1;
+    const uint64_t sub_bucket = bucket % LATENCY_SUB_BUCKET_COUNT;
+    return ((LATENCY_SUB_BUCKET_COUNT + sub_bucket + 1) << shift) - 1;
+}
+
+chrono::microseconds RequestQueue::GetPercentile(const array<uint64_t, LATENCY_BUCKET_COUNT>& histogram,
+                                                 uint64_t count, double share) {
+    if (count == 0) {
+        return chrono::microseconds(0);
+    }
+    const uint64_t rank = clamp<uint64_t>(static_cast<uint64_t>(ceil(share * count)), 1, count);
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        cumulative += histogram[bucket];
+        if (cumulative >= rank) {
+            return chrono::microseconds(GetLatencyBucketUpperBound(bucket));
+        }
+    }
+    return chrono::microseconds(GetLatencyBucketUpperBound(LATENCY_BUCKET_COUNT - 1));
+}
@@ -1,57 +1,135 @@
 #pragma once
 
-#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <string>
 
+#include "concurrent_map.h"
 #include "document.h"
 
+#include "query_cache.h"
 #include "search_server.h"
 
+/* Default time window of request statistics */
+const std::chrono::minutes REQUEST_WINDOW{1440};
+
+/* Statistics of requests for the last time window (a day by default), shared by query threads.
+   Requests of the current minute are counted by atomic counters, which are split into stripes
+   by thread, without locks. When the minute is over, its counts are moved to a sparse record of
+   the minute and added to the sums of the window, minutes leaving the window are subtracted.
+   So the queue is locked once per minute by writers, and a reader sums only the window and
+   the current minute.
+   Latencies are counted in a log-linear histogram (HDR-style): values below 8 microseconds
+   are exact, greater values are grouped with relative error at most 1/8 */
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+    explicit RequestQueue(const SearchServer& search_server, std::chrono::minutes window = REQUEST_WINDOW,
+                          Clock clock = std::chrono::steady_clock::now);
+    /* Requests by status go through the cache, requests with a predicate go to its server */
+    explicit RequestQueue(QueryCache& query_cache, std::chrono::minutes window = REQUEST_WINDOW,
+                          Clock clock = std::chrono::steady_clock::now);
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
-   
+
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
-    
+
+    /* Registers a request, which was executed by the caller */
+    void AddRequest(bool is_no_result, std::chrono::steady_clock::duration latency);
+
+    /* Statistics for the window. They can be read concurrently with adding of requests */
     int GetNoResultRequests() const;
+    uint64_t GetRequestCount() const;
+
+    struct LatencyStats {
+        uint64_t request_count = 0;
+        std::chrono::microseconds p50{0};
+        std::chrono::microseconds p99{0};
+        std::chrono::microseconds p999{0};
+        std::chrono::microseconds max{0};
+    };
+    LatencyStats GetLatencyStats() const;
+    /* Latency, which share of requests doesn't exceed (up to the histogram precision). Zero without requests */
+    std::chrono::microseconds GetLatencyPercentile(double share) const;
 
 private:
-    struct QueryResult {
-        bool is_no_result;
+    static constexpr size_t STRIPE_COUNT = 8;
+    static constexpr uint32_t LATENCY_SUB_BUCKET_BITS = 3;
+    static constexpr size_t LATENCY_SUB_BUCKET_COUNT = size_t{1} << LATENCY_SUB_BUCKET_BITS;
+    /* Latencies up to 2^32 - 1 microseconds (more than an hour), greater ones are counted in the last bucket */
+    static constexpr size_t LATENCY_BUCKET_COUNT = (32 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_COUNT;
+
+    /* Requests of similar latency hit the same bucket, so every stripe has its own histogram */
+    struct alignas(CACHE_LINE_SIZE) Stripe {
+        std::atomic<uint64_t> request_count{0};
+        std::atomic<uint64_t> no_result_count{0};
+        std::array<std::atomic<uint32_t>, LATENCY_BUCKET_COUNT> latency_buckets{};
     };
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
+
+    /* Counts of a finished minute. Latencies are {bucket, count} of non-empty buckets */
+    struct MinuteCounts {
+        int64_t minute = 0;
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        std::vector<std::pair<uint16_t, uint32_t>> latency_buckets;
+    };
+
+    struct WindowCounts {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_buckets{};
+
+        void Add(const MinuteCounts& counts);
+        void Subtract(const MinuteCounts& counts);
+    };
+
     const SearchServer& search_server_;
-    int number_of_requests_ = 0;
-    int number_of_no_result_requests_ = 0;
+    QueryCache* query_cache_ = nullptr;
+    Clock clock_;
+    int64_t window_;        /* minutes */
+
+    /* Minute since the clock epoch, which the stripes count */
+    std::atomic<int64_t> current_minute_{std::numeric_limits<int64_t>::min()};
+    std::array<Stripe, STRIPE_COUNT> stripes_;
+
+    /* Guards finished minutes and their sums */
+    mutable std::mutex window_mutex_;
+    /* Finished minutes with requests, in order of minutes */
+    std::deque<MinuteCounts> finished_minutes_;
+    /* Sums of finished_minutes_ */
+    WindowCounts finished_counts_;
+
+    int64_t GetCurrentMinute() const;
+    /* Under window_mutex_: moves counts of the stripes to finished minutes and starts counting
+       the minute. Drops finished minutes, which left the window ending at the minute */
+    void StartMinute(int64_t minute);
+    /* Counts of the window ending at the current minute */
+    WindowCounts GetWindowCounts() const;
+
+    static size_t GetLatencyBucket(uint64_t microseconds);
+    static uint64_t GetLatencyBucketUpperBound(size_t bucket);
+    static std::chrono::microseconds GetPercentile(const std::array<uint64_t, LATENCY_BUCKET_COUNT>& histogram,
+                                                   uint64_t count, double share);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    /* Счётчик запросов */
-    if (number_of_requests_ == min_in_day_) {
-        /* Прошло больше суток. Удаляем лишний (1-й) запрос из очереди
-           Значение счётчика запросов больше не меняется  */
-        /* Уменьшаем счётчик пустых запросов, если удаляемый запрос был пустой */
-        if (requests_.front().is_no_result) {
-            --number_of_no_result_requests_;
-        }
-        requests_.pop_front();
-    } else {
-        ++number_of_requests_;
-    }
-    /* Добавляем новый запрос в очередь, проверив его на результативность */
-    QueryResult result;
+    const auto start = std::chrono::steady_clock::now();
     auto search_results = search_server_.FindTopDocuments(raw_query, document_predicate);
-    result.is_no_result = search_results.empty();
-    requests_.push_back(result);
-    
-    if (result.is_no_result) ++number_of_no_result_requests_;   /* Обновляем счётчик пустых запросов */
-    
+    AddRequest(search_results.empty(), std::chrono::steady_clock::now() - start);
     return search_results;
-}
\ No newline at end of file
+}
@@ -1,17 +1,18 @@
-#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <numeric>
 
 #include "search_server.h"
 
 using namespace std;
 
-SearchServer::SearchServer(const string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+SearchServer::SearchServer(const string& stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(SplitIntoWords(stop_words_text), resource)  // Invoke delegating constructor from string container
 {
 }
 
-SearchServer::SearchServer(string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+SearchServer::SearchServer(string_view stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(SplitIntoWords(stop_words_text), resource)  // Invoke delegating constructor from string container
 {
 }
 
@@ -19,159 +20,483 @@ void SearchServer::AddDocument(int document_id, const string_view document,
                                     DocumentStatus status, const vector<int>& ratings) {
     
     if (document_id < 0) throw invalid_argument("Invalid document_id"s);
-    if (documents_.count(document_id) > 0) throw invalid_argument("document_id already exist"s);
+    if (documents_.Find(document_id) != NO_DOCUMENT) throw invalid_argument("document_id already exist"s);
 
-    const vector<string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / static_cast<double>(words.size());
+    /* Buffer is reused by documents added from the same thread */
+    thread_local vector<string_view> words;
+    SplitIntoWordsNoStop(document, words);
 
+    vector<TermId> terms;
+    terms.reserve(words.size());
     for (const string_view word : words) {
-        word_to_document_freqs_[string{word}][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+        terms.push_back(dictionary_.Add(word));
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.push_back(document_id);    
+    sort(terms.begin(), terms.end());
+
+    const DocumentOrdinal ordinal = documents_.Add(document_id, ComputeAverageRating(ratings), status);
+    index_.SetDocumentLength(ordinal, words.size());
+    auto& term_freqs = document_term_freqs_.emplace_back();
+    for (size_t i = 0; i < terms.size();) {
+        /* Index stores count of the term, frequency is computed from it in the same way */
+        const size_t first = i;
+        while (i < terms.size() && terms[i] == terms[first]) ++i;
+        const uint32_t count = static_cast<uint32_t>(i - first);
+        index_.AddPosting(terms[first], ordinal, count);
+        term_freqs.push_back({terms[first], index_.GetTermFreq(ordinal, count)});
+    }
+    index_.MergeIfNeeded();
+
+    status_documents_[static_cast<size_t>(status)].Add(ordinal);
+    index_.SetDocumentCount(GetDocumentCount());
+    ++generation_;
+}
+
+SearchServer::ParsedDocument SearchServer::ParseDocument(const string_view text) const {
+    ParsedDocument result;
+    try {
+        thread_local vector<string_view> words;
+        SplitIntoWordsNoStop(text, words);
+        result.word_count = words.size();
+
+        sort(words.begin(), words.end());
+        for (const string_view word : words) {
+            if (result.word_counts.empty() || result.word_counts.back().first != word) {
+                result.word_counts.push_back({word, 0});
+            }
+            ++result.word_counts.back().second;
+        }
+    } catch (...) {
+        result.error = current_exception();
+    }
+    return result;
+}
+
+vector<PostingIndex::TermPosting> SearchServer::RegisterDocuments(const vector<const DocumentRecord*>& records,
+                                                                  const vector<ParsedDocument>& parsed_documents,
+                                                                  vector<exception_ptr>& errors) {
+    vector<PostingIndex::TermPosting> postings;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const DocumentRecord& record = *records[i];
+        const ParsedDocument& parsed = parsed_documents[i];
+
+        /* Same checks and order of checks as at AddDocument */
+        if (record.id < 0) {
+            errors[i] = make_exception_ptr(invalid_argument("Invalid document_id"s));
+            continue;
+        }
+        if (documents_.Find(record.id) != NO_DOCUMENT) {
+            errors[i] = make_exception_ptr(invalid_argument("document_id already exist"s));
+            continue;
+        }
+        if (parsed.error) {
+            errors[i] = parsed.error;
+            continue;
+        }
+
+        const DocumentOrdinal ordinal = documents_.Add(record.id, ComputeAverageRating(record.ratings), record.status);
+        index_.SetDocumentLength(ordinal, parsed.word_count);
+        vector<pair<TermId, uint32_t>> term_counts;
+        for (const auto& [word, count] : parsed.word_counts) {
+            term_counts.push_back({dictionary_.Add(word), count});
+        }
+        sort(term_counts.begin(), term_counts.end());
+        auto& term_freqs = document_term_freqs_.emplace_back();
+        for (const auto& [term, count] : term_counts) {
+            term_freqs.push_back({term, index_.GetTermFreq(ordinal, count)});
+            postings.push_back({term, {ordinal, count}});
+        }
+
+        status_documents_[static_cast<size_t>(record.status)].Add(ordinal);
+    }
+    return postings;
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query,
-                            [status](int document_id, DocumentStatus document_status, int rating) {
-                                [document_id](){};
-                                [rating](){};
-                                return document_status == status; });
+    return FindTopDocuments(execution::seq, raw_query, status);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status,
+                                                const CancellationToken& token) const {
+    token.ThrowIfCancelled();
+    const auto query = ParseQuery(raw_query);
+    if (query.plus_terms.empty()) return {};
+    const StatusFilter document_filter{status_documents_[static_cast<size_t>(status)]};
+    if (scoring_mode_ == ScoringMode::BLOCK_MAX_WAND) {
+        return FindAllDocumentsWand(query, document_filter, token);
+    }
+    return FindAllDocumentsByRanges(query, document_filter,
+                                    numeric_limits<size_t>::max(),
+                                    [&token](size_t part_count, const auto& score_part) {
+                                        for (size_t part = 0; part < part_count; ++part) {
+                                            token.ThrowIfCancelled();
+                                            score_part(part);
+                                        }
+                                    });
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries,
+                                                           DocumentStatus status) const {
+    // parse all queries, then group queries by their terms
+    vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+
+    struct BatchTerm {
+        TermId term;
+        double inverse_document_freq;
+        vector<uint32_t> queries;          // indices of queries containing the term
+    };
+    map<TermId, vector<uint32_t>> minus_term_queries;
+    map<TermId, vector<uint32_t>> plus_term_queries;
+    for (uint32_t query = 0; query < queries.size(); ++query) {
+        if (queries[query].plus_terms.empty()) continue;
+        for (const TermId term : queries[query].plus_terms) {
+            if (index_.GetDocumentFreq(term) > 0) plus_term_queries[term].push_back(query);
+        }
+        for (const TermId term : queries[query].minus_terms) {
+            minus_term_queries[term].push_back(query);
+        }
+    }
+    vector<vector<Document>> results(queries.size());
+    if (plus_term_queries.empty()) return results;
+
+    /* Plus terms of every query are sorted by words, so that terms of the batch are traversed
+       in order of words: relevance of a document is summed in the same order as by FindTopDocuments */
+    vector<BatchTerm> plus_terms;
+    TermId longest_term = NO_TERM;
+    for (auto& [term, term_queries] : plus_term_queries) {
+        plus_terms.push_back({term, index_.GetInverseDocumentFreq(term), move(term_queries)});
+        if (longest_term == NO_TERM || index_.GetDocumentFreq(term) > index_.GetDocumentFreq(longest_term)) {
+            longest_term = term;
+        }
+    }
+    sort(plus_terms.begin(), plus_terms.end(), [this](const BatchTerm& lhs, const BatchTerm& rhs) {
+        return dictionary_.GetWord(lhs.term) < dictionary_.GetWord(rhs.term);
+    });
+
+    vector<DocumentBitmap> excluded_documents(queries.size());
+    for (const auto& [term, term_queries] : minus_term_queries) {
+        index_.ForEachPosting(term, [&](DocumentOrdinal ordinal, double) {
+            for (const uint32_t query : term_queries) {
+                excluded_documents[query].Add(ordinal);
+            }
+        });
+    }
+
+    // score ranges of documents in parallel, every range has accumulators and top documents of all queries
+    const StatusFilter document_filter{status_documents_[static_cast<size_t>(status)]};
+    const vector<DocumentOrdinal> part_begins = SplitDocumentRanges(longest_term, GetParallelPartCount());
+    vector<vector<TopDocuments>> part_tops(part_begins.size());
+    ForEachPart(part_begins.size(), [&](size_t part) {
+        const DocumentOrdinal first_ordinal = part_begins[part];
+        const DocumentOrdinal last_ordinal = part + 1 < part_begins.size()
+                                             ? part_begins[part + 1] - 1
+                                             : numeric_limits<DocumentOrdinal>::max();
+        vector<DocumentAccumulator> document_to_relevance(queries.size());
+
+        for (const BatchTerm& plus_term : plus_terms) {
+            index_.ForEachPosting(plus_term.term, first_ordinal, last_ordinal,
+                                  [&](DocumentOrdinal ordinal, double term_freq) {
+                const bool is_accepted = document_filter.Accept(ordinal);
+                for (const uint32_t query : plus_term.queries) {
+                    if (excluded_documents[query].Contains(ordinal)) continue;
+                    auto [entry, is_new] = document_to_relevance[query].Insert(ordinal);
+                    if (is_new) {
+                        entry.is_accepted = is_accepted;
+                    }
+                    if (entry.is_accepted) {
+                        entry.relevance += term_freq * plus_term.inverse_document_freq;
+                    }
+                }
+            });
+        }
+
+        part_tops[part].assign(queries.size(), TopDocuments{max_result_document_count_});
+        for (size_t query = 0; query < queries.size(); ++query) {
+            document_to_relevance[query].ForEach([&](const DocumentAccumulator::Entry& entry) {
+                if (entry.is_accepted) {
+                    part_tops[part][query].Push({documents_.GetId(entry.ordinal), entry.relevance,
+                                                 documents_.GetRating(entry.ordinal)});
+                }
+            });
+        }
+    });
+
+    for (size_t query = 0; query < queries.size(); ++query) {
+        TopDocuments top_documents(max_result_document_count_);
+        for (const auto& tops : part_tops) {
+            top_documents.Merge(tops[query]);
+        }
+        results[query] = move(top_documents).Build();
+    }
+    return results;
+}
+
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(documents_.GetSize());
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+void SearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+}
+
+size_t SearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void SearchServer::SetScoringMode(ScoringMode mode) {
+    scoring_mode_ = mode;
+}
+
+ScoringMode SearchServer::GetScoringMode() const {
+    return scoring_mode_;
 }
 
-const vector<int>::const_iterator SearchServer::begin() const {
-    return document_ids_.begin();
+void SearchServer::SetExecutor(QueryExecutor* executor) {
+    executor_ = executor;
 }
 
-const vector<int>::const_iterator SearchServer::end() const {
-    return document_ids_.end();
+QueryExecutor* SearchServer::GetExecutor() const {
+    return executor_;
+}
+
+SearchServer::TermStats SearchServer::GetTermStats(string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    if (term == NO_TERM) {
+        return {};
+    }
+    return index_.GetTermStats(term);
+}
+
+pmr::memory_resource* SearchServer::GetMemoryResource() const {
+    return documents_.GetMemoryResource();
+}
+
+DocumentStore::IdIterator SearchServer::begin() const {
+    return documents_.begin();
+}
+
+DocumentStore::IdIterator SearchServer::end() const {
+    return documents_.end();
 }
 
 /* Get words frequencies by doc_id. Output: map{word, frequency} */
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double> empty_map_{};
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    map<string_view, double> word_freqs;
 
-    auto find_it = document_to_word_freqs_.find(document_id);
-    if (find_it != document_to_word_freqs_.end()) {     /* check if doc_id exist at server */
-        return find_it->second;
+    const DocumentOrdinal ordinal = documents_.Find(document_id);
+    if (ordinal != NO_DOCUMENT) {     /* check if doc_id exist at server */
+        for (const auto& [term, term_freq] : document_term_freqs_[ordinal]) {
+            word_freqs.emplace(dictionary_.GetWord(term), term_freq);
+        }
     }
-    return empty_map_;
+    return word_freqs;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    {
-        auto it_find = find(document_ids_.begin(), document_ids_.end(), document_id);
-        /* check if doc_id exist at server */
-        if (it_find == document_ids_.end()) return;
+    RemoveDocuments(execution::seq, array<int, 1>{document_id});
+}
+
+void SearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id) {
+    RemoveDocuments(policy, array<int, 1>{document_id});
+}
+
+void SearchServer::RemoveDocument(execution::parallel_policy policy, int document_id) {
+    RemoveDocuments(policy, array<int, 1>{document_id});
+}
+
+vector<TermId> SearchServer::MarkRemoved(const vector<int>& document_ids) {
+    vector<TermId> terms;
+    for (const int document_id : document_ids) {
+        const DocumentOrdinal ordinal = documents_.Find(document_id);
+        /* check if doc_id exist at server. Repeated id isn't found, it is already removed */
+        if (ordinal == NO_DOCUMENT) continue;
+
+        /* Postings stay at index_ until compaction, only document frequencies are updated */
+        for (const auto& [term, _] : document_term_freqs_[ordinal]) {
+            terms.push_back(term);
+        }
 
-        /* Delete from document_ids_ */
-        document_ids_.erase(it_find);
+        /* delete from document_term_freqs_ */
+        document_term_freqs_.Clear(ordinal);
+
+        /* mark as removed at documents_ */
+        status_documents_[static_cast<size_t>(documents_.GetStatus(ordinal))].Remove(ordinal);
+        documents_.Remove(ordinal);
+    }
+    return terms;
+}
+
+void SearchServer::CompactIndex() {
+    const vector<DocumentOrdinal> new_ordinals = documents_.Compact();
+    index_.Compact(new_ordinals);
+
+    /* Term frequencies and status bitmaps follow new ordinals */
+    /* Chunks may be shared with copies of the server, so term frequencies are copied */
+    ForwardIndex document_term_freqs(document_term_freqs_.GetMemoryResource());
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] != NO_DOCUMENT) {
+            const auto term_freqs = document_term_freqs_[ordinal];
+            document_term_freqs.emplace_back().assign(term_freqs.begin(), term_freqs.end());
+        }
+    }
+    document_term_freqs_ = move(document_term_freqs);
+
+    for (DocumentBitmap& status_documents : status_documents_) {
+        status_documents = DocumentBitmap(GetMemoryResource());
+    }
+    for (DocumentOrdinal ordinal = 0; ordinal < static_cast<DocumentOrdinal>(documents_.GetOrdinalCount()); ++ordinal) {
+        status_documents_[static_cast<size_t>(documents_.GetStatus(ordinal))].Add(ordinal);
+    }
+}
+
+void SearchServer::SaveSnapshot(ostream& output) const {
+    SnapshotWriter writer(output);
+    writer.WriteValue(static_cast<uint64_t>(stop_words_.size()));
+    for (const string& stop_word : stop_words_) {
+        writer.WriteString(stop_word);
     }
+    writer.WriteValue(static_cast<uint64_t>(max_result_document_count_));
+    writer.WriteValue(scoring_mode_);
+    writer.WriteValue(compaction_threshold_);
+
+    dictionary_.Save(writer);
+    documents_.Save(writer);
 
-    /* delete from word_frequencies_for_doc_id_ */
-    for (const auto& [word, _] : document_to_word_freqs_.at(document_id)) {
-        auto it = word_to_document_freqs_.find(word);
-        auto& id_freq = it->second;
-        id_freq.erase(document_id);
+    document_term_freqs_.Save(writer);
+
+    index_.Save(writer);
+    writer.Finish();
+}
 
-        /* delete word from word_to_document, if no more documents with this word */
-        if (id_freq.empty()) {
-            word_to_document_freqs_.erase(it);
+void SearchServer::SaveSnapshot(const string& path) const {
+    /* Snapshot is written aside and renamed over path, so the file at path is always complete,
+       and processes, which have mapped the old file, keep its inode */
+    const string temporary_path = path + ".tmp"s;
+    try {
+        ofstream output(temporary_path, ios::binary | ios::trunc);
+        if (!output) {
+            throw ios_base::failure("Can't create "s + temporary_path);
         }
+        SaveSnapshot(output);
+        output.close();
+        if (!output) {
+            throw ios_base::failure("Can't write "s + temporary_path);
+        }
+    } catch (...) {
+        remove(temporary_path.c_str());
+        throw;
+    }
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        remove(temporary_path.c_str());
+        throw ios_base::failure("Can't replace "s + path);
     }
+}
 
-    /* delete from document_to_word_freqs_ */
-    document_to_word_freqs_.erase(document_id);
+SearchServer SearchServer::OpenSnapshot(const string& path, pmr::memory_resource* resource) {
+    auto file = make_shared<const MappedFile>(path);
+    SnapshotReader reader(file->GetData(), file->GetSize());
 
-    /* delete from documents_ */
-    documents_.erase(document_id);
+    vector<string> stop_words(reader.ReadValue<uint64_t>());
+    for (string& stop_word : stop_words) {
+        stop_word = reader.ReadString();
+    }
+    SearchServer server(stop_words, resource);
+    server.max_result_document_count_ = reader.ReadValue<uint64_t>();
+    /* Checksum detects damage of the file, but not invalid values of a foreign writer */
+    server.scoring_mode_ = reader.ReadValue<ScoringMode>();
+    if (server.scoring_mode_ != ScoringMode::EXHAUSTIVE && server.scoring_mode_ != ScoringMode::BLOCK_MAX_WAND) {
+        throw SnapshotError("Snapshot has invalid scoring mode"s);
+    }
+    server.compaction_threshold_ = reader.ReadValue<double>();
+    if (!IsValidCompactionThreshold(server.compaction_threshold_)) {
+        throw SnapshotError("Snapshot has invalid compaction threshold"s);
+    }
+
+    server.dictionary_.Load(reader, file);
+    server.documents_.Load(reader);
+    const size_t ordinal_count = server.documents_.GetOrdinalCount();
+    server.document_term_freqs_.Load(reader, file, ordinal_count);
+    server.index_.Load(reader, move(file));
+    reader.Finish();
+    if (server.index_.GetTermCount() != server.dictionary_.GetSize()) {
+        throw SnapshotError("Snapshot has inconsistent posting index"s);
+    }
+
+    for (DocumentOrdinal ordinal = 0; ordinal < static_cast<DocumentOrdinal>(ordinal_count); ++ordinal) {
+        const size_t status = static_cast<size_t>(server.documents_.GetStatus(ordinal));
+        if (status >= STATUS_COUNT) {
+            throw SnapshotError("Snapshot has invalid document status"s);
+        }
+        if (!server.documents_.IsRemoved(ordinal)) {
+            server.status_documents_[status].Add(ordinal);
+        }
+    }
+    server.index_.SetDocumentCount(server.GetDocumentCount());
+    return server;
 }
 
-void SearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id) {
-    [policy](){};
-    RemoveDocument(document_id);
+void SearchServer::CompactIndexIfNeeded() {
+    const size_t removed_count = documents_.GetOrdinalCount() - documents_.GetSize();
+    if (removed_count > compaction_threshold_ * static_cast<double>(documents_.GetOrdinalCount())) {
+        CompactIndex();
+    }
 }
 
-void SearchServer::RemoveDocument(execution::parallel_policy policy, int document_id) {
-    [policy](){};
-    
-    if (documents_.empty() || word_to_document_freqs_.empty()) return;
+void SearchServer::SetCompactionThreshold(double removed_document_share) {
+    if (!IsValidCompactionThreshold(removed_document_share)) {
+        throw invalid_argument("Compaction threshold must be in [0, 1]"s);
+    }
+    compaction_threshold_ = removed_document_share;
+    CompactIndexIfNeeded();
+}
 
-    {
-        auto it = find(document_ids_.begin(), document_ids_.end(), document_id);
-        if (it == document_ids_.end()) return;  /* check if doc_id exist at server */
-        document_ids_.erase(it);                /* Delete from document_ids_ */
-    }
-
-    auto doc_ptr = document_to_word_freqs_.find(document_id);    /* pointer to <document_id, map<word, freq>> with specified document_id  */
-    if (doc_ptr == document_to_word_freqs_.end()) return;
-    auto& word_freqs = doc_ptr->second;                          /* = document_to_word_freqs_.at(document_id) */
-
-    /* delete from word_to_document_freq_ */
-    /* parallel version */
-    vector<string_view> document_words{word_freqs.size()};
-    transform(execution::par, 
-              word_freqs.begin(),
-              word_freqs.end(),
-              document_words.begin(),
-              [](const auto& word_freq){ return word_freq.first; });
-
-    for_each(execution::par, 
-             document_words.begin(),
-             document_words.end(),
-             [this, document_id](const string_view word){ 
-                    const auto word_ptr = word_to_document_freqs_.find(word);
-                    //assert(word_ptr != word_to_document_freqs_.end());
-                    auto& id_freq = word_ptr->second;         /* = word_to_document_freqs_.at(word) */
-                    id_freq.erase(document_id);
-
-                    /* delete word from word_to_document, if no more documents with this word */
-                    if (id_freq.empty()) {
-                        word_to_document_freqs_.erase(word_ptr);
-                    } 
-                    });
-
-    /* delete from document_to_word_freqs_ */
-    document_to_word_freqs_.erase(doc_ptr);
-
-    /* delete from documents_ */
-    documents_.erase(document_id);
+double SearchServer::GetCompactionThreshold() const {
+    return compaction_threshold_;
+}
+
+bool SearchServer::IsValidCompactionThreshold(double removed_document_share) {
+    /* NaN is rejected too */
+    return removed_document_share >= 0.0 && removed_document_share <= 1.0;
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
     
-    auto doc_ptr = document_to_word_freqs_.find(document_id);
-    if (doc_ptr == document_to_word_freqs_.end()) {
+    const DocumentOrdinal ordinal = documents_.Find(document_id);
+    if (ordinal == NO_DOCUMENT) {
         throw std::out_of_range("Invalid document id: "s + to_string(document_id));
     }
-    const auto& word_freqs = doc_ptr->second;
+    const auto& term_freqs = document_term_freqs_[ordinal];
     
     Query query = ParseQuery(raw_query);
     
     /* Check for minus words */
-    if (any_of( query.minus_words.begin(), query.minus_words.end(),
-                [&word_freqs](const string_view minus_word){ 
-                    return word_freqs.count(minus_word); }))
+    if (any_of( query.minus_terms.begin(), query.minus_terms.end(),
+                [&term_freqs](const TermId minus_term){ 
+                    return ContainsTerm(term_freqs, minus_term); }))
     {
-        return {vector<string_view> {}, documents_.at(document_id).status};
+        return {vector<string_view> {}, documents_.GetStatus(ordinal)};
     }
 
     /* Check for plus words */
-    tuple<vector<string_view>, DocumentStatus> result{vector<string_view>{}, documents_.at(document_id).status};
+    tuple<vector<string_view>, DocumentStatus> result{vector<string_view>{}, documents_.GetStatus(ordinal)};
     auto& matched_words = get<vector<string_view>>(result);
     
-    std::copy_if(query.plus_words.begin(), query.plus_words.end(), back_inserter(matched_words),
-            [&word_freqs](const string_view plus_word){
-                return word_freqs.count(plus_word); });
+    for (const TermId plus_term : query.plus_terms) {
+        if (ContainsTerm(term_freqs, plus_term)) {
+            matched_words.push_back(dictionary_.GetWord(plus_term));
+        }
+    }
 
     return result;
 }
@@ -186,30 +511,33 @@ tuple<vector<string_view>, DocumentStatus>
 SearchServer::MatchDocument(std::execution::parallel_policy policy, const string_view raw_query, int document_id) const {
     [policy](){};
 
-    auto doc_ptr = document_to_word_freqs_.find(document_id);
-    if (doc_ptr == document_to_word_freqs_.end()) {
+    const DocumentOrdinal ordinal = documents_.Find(document_id);
+    if (ordinal == NO_DOCUMENT) {
         throw std::out_of_range("Invalid document id: "s + to_string(document_id));
     }
-    const auto& word_freqs = doc_ptr->second;
+    const auto& term_freqs = document_term_freqs_[ordinal];
 
     Query query = ParParseQuery(raw_query);
 
     /* Check for minus words */
-    if (any_of(execution::par, query.minus_words.cbegin(), query.minus_words.cend(),
-                [&word_freqs](const string_view minus_word){
-                    return word_freqs.count(minus_word); }))
+    if (any_of(execution::par, query.minus_terms.cbegin(), query.minus_terms.cend(),
+                [&term_freqs](const TermId minus_term){
+                    return ContainsTerm(term_freqs, minus_term); }))
     {
-        return {vector<string_view> {}, documents_.at(document_id).status};
+        return {vector<string_view> {}, documents_.GetStatus(ordinal)};
     }
 
     /* Check for plus words */
-    tuple<vector<string_view>, DocumentStatus> result{vector<string_view>{query.plus_words.size()}, documents_.at(document_id).status};
+    vector<TermId> matched_terms(query.plus_terms.size());
+    auto last = std::copy_if(execution::par, query.plus_terms.begin(), query.plus_terms.end(), matched_terms.begin(),
+                        [&term_freqs](const TermId plus_term){ 
+                            return ContainsTerm(term_freqs, plus_term); });
+    matched_terms.erase(last, matched_terms.end());     // oversize correction
+
+    tuple<vector<string_view>, DocumentStatus> result{vector<string_view>{matched_terms.size()}, documents_.GetStatus(ordinal)};
     auto& matched_words = get<vector<string_view>>(result);
-    
-    auto last = std::copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
-                        [&word_freqs](const string_view plus_word){ 
-                            return word_freqs.count(plus_word); });
-    matched_words.erase(last, matched_words.end());     // oversize correction
+    transform(matched_terms.begin(), matched_terms.end(), matched_words.begin(),
+              [this](const TermId term){ return dictionary_.GetWord(term); });
 
     /* Delete duplicates from matched_words */
     std::sort(matched_words.begin(), matched_words.end());
@@ -220,7 +548,7 @@ SearchServer::MatchDocument(std::execution::parallel_policy policy, const string
 }
 
 bool SearchServer::IsStopWord(const string_view word) const {
-    return stop_words_.count(word) != 0;
+    return stop_word_set_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const string_view word) {
@@ -228,17 +556,17 @@ bool SearchServer::IsValidWord(const string_view word) {
     return none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-    vector<string_view> words;
-    for (const string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
+void SearchServer::SplitIntoWordsNoStop(const string_view text, vector<string_view>& words) const {
+    words.clear();
+    for (Tokenizer tokenizer(text); tokenizer.Next();) {
+        const string_view word = tokenizer.GetWord();
+        if (!tokenizer.IsValid()) {
             throw invalid_argument("Word "s + string{word} + " is invalid"s);
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
     }
-    return words;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -250,7 +578,7 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text, bool is_valid) const {
     if (text.empty()) {
         throw invalid_argument("Query word is empty"s);
     }
@@ -260,16 +588,50 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) con
         is_minus = true;
         word.remove_prefix(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-' || !is_valid) {
         throw invalid_argument("Query word "s + string{text} + " is invalid");
     }
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParParseQuery(const string_view text) const {
-    Query result;
-    for (const string_view word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
+DocumentBitmap SearchServer::GetExcludedDocuments(const Query& query) const {
+    DocumentBitmap excluded_documents;
+    for (const TermId term : query.minus_terms) {
+        index_.ForEachPosting(term, [&excluded_documents](int document_id, double) {
+            excluded_documents.Add(document_id);
+        });
+    }
+    return excluded_documents;
+}
+
+vector<DocumentOrdinal> SearchServer::SplitDocumentRanges(TermId term, size_t max_part_count) const {
+    const size_t MIN_POSTINGS_PER_PART = 1024;
+    const size_t part_count = max<size_t>(1, min<size_t>(
+            max_part_count,
+            index_.GetDocumentFreq(term) / MIN_POSTINGS_PER_PART));
+    vector<DocumentOrdinal> part_begins{0};
+    for (const DocumentOrdinal ordinal : index_.SplitPostings(term, part_count)) {
+        part_begins.push_back(ordinal);
+    }
+    return part_begins;
+}
+
+size_t SearchServer::GetParallelPartCount() const {
+    const size_t PARTS_PER_THREAD = 4;
+    const size_t thread_count = executor_ != nullptr ? executor_->GetThreadCount() : thread::hardware_concurrency();
+    return thread_count * PARTS_PER_THREAD;
+}
+
+bool SearchServer::ContainsTerm(ArrayView<TermFreq> term_freqs, TermId term) {
+    const auto it = lower_bound(term_freqs.begin(), term_freqs.end(), term,
+                                [](const auto& term_freq, TermId term){ return term_freq.term < term; });
+    return it != term_freqs.end() && it->term == term;
+}
+
+SearchServer::QueryWords SearchServer::ParseQueryWords(const string_view text) const {
+    QueryWords result;
+    for (Tokenizer tokenizer(text); tokenizer.Next();) {
+        const auto query_word = ParseQueryWord(tokenizer.GetWord(), tokenizer.IsValid());
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 result.minus_words.push_back(query_word.data);
@@ -282,26 +644,54 @@ SearchServer::Query SearchServer::ParParseQuery(const string_view text) const {
     return result;
 }
 
+SearchServer::Query SearchServer::ResolveQuery(const QueryWords& query_words) const {
+    Query result;
+    for (size_t i = 0; i < query_words.plus_words.size(); ++i) {
+        const TermId term = dictionary_.Find(query_words.plus_words[i]);
+        if (term == NO_TERM) continue;
+        result.plus_terms.push_back(term);
+        if (!query_words.inverse_document_freqs.empty()) {
+            result.inverse_document_freqs.push_back(query_words.inverse_document_freqs[i]);
+        }
+    }
+    for (const string_view word : query_words.minus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM) result.minus_terms.push_back(term);
+    }
+    return result;
+}
+
+SearchServer::Query SearchServer::ParParseQuery(const string_view text) const {
+    return ResolveQuery(ParseQueryWords(text));
+}
+
 SearchServer::Query SearchServer::ParseQuery(const string_view text) const {
-    Query result = ParParseQuery(text);
+    QueryWords result = ParseQueryWords(text);
+    RemoveDuplicateWords(result);
+    return ResolveQuery(result);
+}
 
-    /* Delete duplicates */
+void SearchServer::RemoveDuplicateWords(QueryWords& query_words) {
     {
-        std::sort(result.minus_words.begin(), result.minus_words.end());
-        auto last = unique(result.minus_words.begin(), result.minus_words.end());
-        result.minus_words.erase(last, result.minus_words.end());
+        std::sort(query_words.minus_words.begin(), query_words.minus_words.end());
+        auto last = unique(query_words.minus_words.begin(), query_words.minus_words.end());
+        query_words.minus_words.erase(last, query_words.minus_words.end());
     }
     {
-        std::sort(result.plus_words.begin(), result.plus_words.end());
-        auto last = unique(result.plus_words.begin(), result.plus_words.end());
-        result.plus_words.erase(last, result.plus_words.end());
+        std::sort(query_words.plus_words.begin(), query_words.plus_words.end());
+        auto last = unique(query_words.plus_words.begin(), query_words.plus_words.end());
+        query_words.plus_words.erase(last, query_words.plus_words.end());
     }
-    
-    return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    auto word_ptr = word_to_document_freqs_.find(word);
-    // assert(word_ptr != word_to_document_freqs_.end());
-    return log(GetDocumentCount() * 1.0 / static_cast<double>(word_ptr->second.size()));
-}
\ No newline at end of file
+double SearchServer::GetInverseDocumentFreq(const Query& query, size_t plus_term_index) const {
+    if (query.inverse_document_freqs.empty()) {
+        return index_.GetInverseDocumentFreq(query.plus_terms[plus_term_index]);
+    }
+    return query.inverse_document_freqs[plus_term_index];
+}
+
+int SearchServer::GetDocumentFreq(string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    return term == NO_TERM ? 0 : index_.GetDocumentFreq(term);
+}
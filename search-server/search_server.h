@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <set>
 #include <map>
 #include <vector>
@@ -10,23 +11,63 @@
 #include <stdexcept>
 #include <limits>
 #include <execution>
+#include <exception>
+#include <numeric>
+#include <memory_resource>
+#include <ostream>
+#include <thread>
 
 #include "string_processing.h"
+#include "cancellation.h"
 #include "document.h"
-#include "concurrent_map.h"
-
+#include "document_bitmap.h"
+#include "document_store.h"
+#include "document_accumulator.h"
+#include "forward_index.h"
+#include "posting_index.h"
+#include "query_executor.h"
+#include "snapshot_format.h"
+#include "term_dictionary.h"
+#include "tokenizer.h"
+#include "top_documents.h"
+
+/* Default number of documents returned by FindTopDocuments */
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+/* Default share of removed documents, at which the index is compacted */
+const double MAX_REMOVED_DOCUMENT_SHARE = 0.25;
+
+/* Query evaluation algorithm of sequenced FindTopDocuments */
+enum class ScoringMode {
+    EXHAUSTIVE,         /* score every posting of every plus word */
+    BLOCK_MAX_WAND,     /* skip documents, that can't get into top documents (dynamic pruning) */
+};
+
 class SearchServer {
 public:
+    /* All index storage (dictionary, postings, document data) is allocated from the memory resource.
+       Pass an arena (e.g. std::pmr::monotonic_buffer_resource) to avoid many small heap allocations
+       while building the index and to free the whole index at once with the arena */
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text);
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string& stop_words_text,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(std::string_view stop_words_text,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    /* Adds a batch of DocumentRecord. Documents are tokenized in parallel and their postings are
+       merged into the index in one pass. Returns error of every document: nullptr if it was added,
+       otherwise the exception, which AddDocument would throw for it */
+    template <typename DocumentRange>
+    std::vector<std::exception_ptr> AddDocuments(const DocumentRange& documents);
+
+    template <typename ExecutionPolicy, typename DocumentRange>
+    std::vector<std::exception_ptr> AddDocuments(ExecutionPolicy policy, const DocumentRange& documents);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
     
@@ -42,19 +83,86 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const;
 
+    /* Top documents of every query of the batch, the same as FindTopDocuments(raw_query, status) gives.
+       Postings of every distinct term of the batch are traversed once, contributions are scattered
+       to accumulators of the queries containing the term. Ranges of documents are scored in parallel */
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    /* Sequenced search, which can be cancelled. Token is checked between ranges of documents
+       with about 1024 postings of the longest plus word, or between steps of Block-Max WAND
+       (see ScoringMode). Throws OperationCancelled */
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           const CancellationToken& token) const;
+
     int GetDocumentCount() const;
 
-    // int GetDocumentId(int index) const;
-    const std::vector<int>::const_iterator begin() const;
-    const std::vector<int>::const_iterator end() const;
+    /* Counter of changes of the document set. It grows, when documents are added or removed,
+       so results of a query can change only together with it */
+    uint64_t GetGeneration() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::pmr::memory_resource* GetMemoryResource() const;
 
-    /* Removes document with specified id */
+    /* Document frequency and IDF of the word. Both are zero for unknown word */
+    using TermStats = PostingIndex::TermStats;
+    TermStats GetTermStats(std::string_view word) const;
+
+    /* Number of documents returned by FindTopDocuments (MAX_RESULT_DOCUMENT_COUNT by default) */
+    void SetMaxResultDocumentCount(size_t count);
+    size_t GetMaxResultDocumentCount() const;
+
+    /* Query evaluation algorithm of sequenced search. Parallel search is always exhaustive */
+    void SetScoringMode(ScoringMode mode);
+    ScoringMode GetScoringMode() const;
+
+    /* Parallel search runs its tasks on the executor instead of the standard library backend,
+       so that it shares threads with queries processed by the same executor.
+       Executor isn't owned and must outlive its use, nullptr resets it */
+    void SetExecutor(QueryExecutor* executor);
+    QueryExecutor* GetExecutor() const;
+
+    /* Ids of documents in order of adding */
+    DocumentStore::IdIterator begin() const;
+    DocumentStore::IdIterator end() const;
+
+    /* Returns map <document word, word frequency at this document>. Empty for unknown document */
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    /* Removes document with specified id. Removal is lazy: the document is marked as removed
+       and is skipped by queries, its postings are dropped by compaction of the index */
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
 
+    /* Removes a batch of documents by ids. Unknown and repeated ids are ignored.
+       Document frequencies of all affected terms are updated in parallel, every task owns its terms */
+    template <typename DocumentIdRange>
+    void RemoveDocuments(const DocumentIdRange& document_ids);
+
+    template <typename ExecutionPolicy, typename DocumentIdRange>
+    void RemoveDocuments(ExecutionPolicy policy, const DocumentIdRange& document_ids);
+
+    /* Drops postings of removed documents. It is done automatically, when share of removed
+       documents exceeds the threshold (MAX_REMOVED_DOCUMENT_SHARE by default) */
+    void CompactIndex();
+    /* Throws std::invalid_argument, if the share isn't in [0, 1]. Share 1 disables automatic compaction */
+    void SetCompactionThreshold(double removed_document_share);
+    double GetCompactionThreshold() const;
+
+    /* Writes versioned binary snapshot of the server: stop words, settings, dictionary,
+       document attributes and term frequencies, merged postings with skip data */
+    void SaveSnapshot(std::ostream& output) const;
+    /* File at path is replaced atomically: the snapshot is written to path + ".tmp" and renamed */
+    void SaveSnapshot(const std::string& path) const;
+
+    /* Maps snapshot file written on the same platform. Checksum is verified, postings are used
+       in place from the mapped pages and are shared with other processes mapping the file.
+       The rest of the server is loaded to the resource. The server can be changed after opening:
+       postings are copied to memory on the first merge or compaction.
+       Throws SnapshotError for invalid snapshot and std::system_error if the file can't be mapped */
+    static SearchServer OpenSnapshot(const std::string& path,
+                                     std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
     /* Returns matched words in specidied document and it's status by request of raw query, 
        that could contains plus and minus words. In case raw query provides minus word(s), 
        that the document contains, the return vector strings wold be empty */
@@ -70,61 +178,180 @@ public:
 private:
     /* Set of stop-words */
     const std::set<std::string, std::less<>> stop_words_;
+    /* Same words with perfect hash lookup, used by tokenization */
+    StopWordSet stop_word_set_;
 
-    /* All documents ids */
-    std::vector<int> document_ids_;
+    /* Attributes of documents (id, rating, status) by document ordinal.
+       Index, bitmaps and term frequencies below refer to documents by ordinals */
+    DocumentStore documents_;
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
-    /* Map <all document ids, DocumentsData{rating, doc status}> */
-    std::map<int, DocumentData> documents_;
+    /* Documents of every status, indexed by DocumentStatus */
+    static constexpr size_t STATUS_COUNT = 4;
+    std::array<DocumentBitmap, STATUS_COUNT> status_documents_;
+
+    /* Dictionary <word, term id>. This is basic owner of all words in documents.
+       Other containers operate with term ids */
+    TermDictionary dictionary_;
 
-    /* Map <all document words, Map <document id, word frequency at this document>>
-       This is basic owner of all words in document. Other containers operate with string_view to this. */
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
+    /* Inverted index <term id, postings {document ordinal, word frequency at this document}> */
+    PostingIndex index_;
     
-    /* Map <all document ids, Map <document words, word frequency at this document>> */
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    /* {term id, word frequency at this document} sorted by term id, indexed by document ordinal.
+       It is shared between copies of the server and refers to the file of an opened snapshot */
+    ForwardIndex document_term_freqs_;
+
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    ScoringMode scoring_mode_ = ScoringMode::EXHAUSTIVE;
+    double compaction_threshold_ = MAX_REMOVED_DOCUMENT_SHARE;
+    uint64_t generation_ = 0;
+    QueryExecutor* executor_ = nullptr;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+
+    /* Marks documents as removed in order, returns terms of all their postings */
+    std::vector<TermId> MarkRemoved(const std::vector<int>& document_ids);
+
+    void CompactIndexIfNeeded();
+
+    struct ParsedDocument {
+        std::vector<std::pair<std::string_view, uint32_t>> word_counts;     /* sorted by word */
+        size_t word_count = 0;
+        std::exception_ptr error;
+    };
+    ParsedDocument ParseDocument(const std::string_view text) const;
+    /* Checks ids and registers parsed documents in order, returns postings of added documents */
+    std::vector<PostingIndex::TermPosting> RegisterDocuments(const std::vector<const DocumentRecord*>& records,
+                                                             const std::vector<ParsedDocument>& parsed_documents,
+                                                             std::vector<std::exception_ptr>& errors);
 
     bool IsStopWord(const std::string_view word) const;
     static bool IsValidWord(const std::string_view word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    /* Splits text into words, validates them and drops stop words in one pass.
+       Words are written to the caller's buffer, which is cleared first */
+    void SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const;
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    /* is_valid tells, that the text has no control characters (see Tokenizer) */
+    QueryWord ParseQueryWord(const std::string_view text, bool is_valid) const;
 
-    struct Query {
+    struct QueryWords {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        /* IDF of plus words given by the caller (global IDF of ShardedSearchServer).
+           Empty, if IDF of the index is used */
+        std::vector<double> inverse_document_freqs;
     };
+    QueryWords ParseQueryWords(const std::string_view text) const;
+    /* Sorts words and deletes duplicates */
+    static void RemoveDuplicateWords(QueryWords& query_words);
+
+    /* Query words are resolved to term ids once. Words, which aren't in dictionary, are dropped:
+       they can't match any document. Plus terms are ordered by their words */
+    struct Query {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        std::vector<double> inverse_document_freqs;     /* of plus terms, empty if IDF of the index is used */
+    };
+    Query ResolveQuery(const QueryWords& query_words) const;
+    /* Query without sorting and deleting duplicates */
     Query ParParseQuery(const std::string_view text) const;
     Query ParseQuery(const std::string_view text) const;
 
+    double GetInverseDocumentFreq(const Query& query, size_t plus_term_index) const;
+    /* Number of documents containing the word */
+    int GetDocumentFreq(std::string_view word) const;
+
+    static bool ContainsTerm(ArrayView<TermFreq> term_freqs, TermId term);
+    static bool IsValidCompactionThreshold(double removed_document_share);
+    /* Documents containing minus words. They are excluded before scoring */
+    DocumentBitmap GetExcludedDocuments(const Query& query) const;
+
+    /* Splits documents into at most max_part_count ranges with nearly equal numbers of postings of the term
+       (at least 1024 postings per range). Returns the first ordinal of every range, the first one is 0 */
+    std::vector<DocumentOrdinal> SplitDocumentRanges(TermId term, size_t max_part_count) const;
+    /* Number of ranges for parallel scoring: a few per thread, so that uneven ranges are balanced */
+    size_t GetParallelPartCount() const;
+    /* Calls function(part) for every part in parallel: on the executor, if it is set */
+    template <typename Function>
+    void ForEachPart(size_t part_count, Function function) const;
+
+    /* Filters of documents for scoring: Accept(ordinal) tells, if the document can be found */
     template <typename DocumentPredicate>
+    struct PredicateFilter {
+        const SearchServer& server;
+        DocumentPredicate document_predicate;
+
+        bool Accept(DocumentOrdinal ordinal) const {
+            const DocumentStore& documents = server.documents_;
+            return !documents.IsRemoved(ordinal) && document_predicate(documents.GetId(ordinal), documents.GetStatus(ordinal), documents.GetRating(ordinal));
+        }
+    };
+    /* Checks the status by bitmap, without lookup of document data. Removed documents aren't in bitmaps */
+    struct StatusFilter {
+        const DocumentBitmap& documents;
+
+        bool Accept(DocumentOrdinal ordinal) const {
+            return documents.Contains(ordinal);
+        }
+    };
+
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    std::vector<Document> FindFilteredDocuments(ExecutionPolicy policy, const std::string_view raw_query,
+                                                DocumentFilter document_filter) const;
+
+    /* Score all documents matching the query and select the best max_result_document_count_ of them.
+       Result is sorted by IsMoreRelevant() */
+    template <typename DocumentFilter>
     std::vector<Document> FindAllDocuments(const Query& query,
-                                      DocumentPredicate document_predicate) const;
+                                      DocumentFilter document_filter) const;
 
-    template <typename DocumentPredicate>
+    template <typename DocumentFilter>
     std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, 
-                                const Query &query, DocumentPredicate document_predicate) const;
+                                const Query &query, DocumentFilter document_filter) const;
 
-    template <typename DocumentPredicate>
+    template <typename DocumentFilter>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, 
-                                const Query &query, DocumentPredicate document_predicate) const;
+                                const Query &query, DocumentFilter document_filter) const;
+
+    /* Block-Max WAND: document-at-a-time evaluation, which skips documents, 
+       whose upper bound of relevance can't get them into top documents */
+    /* Adds score to relevance of the document. Filter is checked once per document */
+    template <typename DocumentFilter>
+    static void AccumulateRelevance(DocumentAccumulator& document_to_relevance, const DocumentFilter& document_filter,
+                                    DocumentOrdinal ordinal, double score);
+    void PushAccepted(const DocumentAccumulator& document_to_relevance, TopDocuments& top_documents) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocumentsWand(const Query &query, DocumentFilter document_filter,
+                                               const CancellationToken& token = CancellationToken()) const;
+
+    /* Document id space is split into ranges, every range is scored with its own accumulator
+       and own top documents, so that ranges don't share any data.
+       run_parts(part_count, score_part) must call score_part(part) for every part */
+    template <typename DocumentFilter, typename RunParts>
+    std::vector<Document> FindAllDocumentsByRanges(const Query &query, DocumentFilter document_filter,
+                                                   size_t max_part_count, RunParts run_parts) const;
+
+    /* Shards are searched with global IDF by their private query interface */
+    friend class ShardedSearchServer;
+    /* Cache keys are built from parsed query words */
+    friend class QueryCache;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+    , stop_word_set_(stop_words_)
+    , documents_(resource)
+    , status_documents_{DocumentBitmap(resource), DocumentBitmap(resource),
+                        DocumentBitmap(resource), DocumentBitmap(resource)}
+    , dictionary_(resource)
+    , index_(resource)
+    , document_term_freqs_(resource)
 {
     if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         {
@@ -134,6 +361,79 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
+template <typename DocumentRange>
+inline std::vector<std::exception_ptr> SearchServer::AddDocuments(const DocumentRange& documents) {
+    return AddDocuments(std::execution::seq, documents);
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+inline std::vector<std::exception_ptr> SearchServer::AddDocuments(ExecutionPolicy policy, const DocumentRange& documents) {
+    std::vector<const DocumentRecord*> records;
+    for (const DocumentRecord& document : documents) {
+        records.push_back(&document);
+    }
+
+    // tokenize documents and compute word frequencies (parallel)
+    std::vector<ParsedDocument> parsed_documents(records.size());
+    std::transform(policy,
+                   records.begin(), records.end(),
+                   parsed_documents.begin(),
+                   [this](const DocumentRecord* record) { return ParseDocument(record->text); });
+
+    // assign term ids and document data (sequenced)
+    std::vector<std::exception_ptr> errors(records.size());
+    auto postings = RegisterDocuments(records, parsed_documents, errors);
+
+    // postings of all documents go to the side buffer of the index, it is merged in bulk
+    std::sort(policy, postings.begin(), postings.end(),
+              [](const PostingIndex::TermPosting& lhs, const PostingIndex::TermPosting& rhs) {
+                  return lhs.term < rhs.term
+                      || (lhs.term == rhs.term && lhs.posting.document_id < rhs.posting.document_id);
+              });
+    index_.AddPostings(postings);
+    index_.SetDocumentCount(GetDocumentCount());
+    ++generation_;
+
+    return errors;
+}
+
+template <typename DocumentIdRange>
+inline void SearchServer::RemoveDocuments(const DocumentIdRange& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
+template <typename ExecutionPolicy, typename DocumentIdRange>
+inline void SearchServer::RemoveDocuments(ExecutionPolicy policy, const DocumentIdRange& document_ids) {
+    // mark documents as removed and collect their terms (sequenced)
+    std::vector<TermId> terms = MarkRemoved({std::begin(document_ids), std::end(document_ids)});
+    ++generation_;
+
+    // group equal terms and split them into parts, which don't share terms
+    std::sort(policy, terms.begin(), terms.end());
+    const size_t MIN_PART_SIZE = 4096;
+    std::vector<size_t> part_begins;
+    for (size_t i = 0; i < terms.size();) {
+        part_begins.push_back(i);
+        i = std::min(i + MIN_PART_SIZE, terms.size());
+        while (i < terms.size() && terms[i] == terms[i - 1]) ++i;
+    }
+    part_begins.push_back(terms.size());
+
+    // update document frequencies (parallel)
+    std::vector<size_t> parts(part_begins.size() - 1);
+    std::iota(parts.begin(), parts.end(), 0);
+    std::for_each(policy,
+                  parts.begin(), parts.end(),
+                  [&](size_t part) {
+                    for (size_t i = part_begins[part]; i < part_begins[part + 1]; ++i) {
+                        index_.DecrementDocumentFreq(terms[i]);
+                    }
+                  });
+
+    index_.SetDocumentCount(GetDocumentCount());
+    CompactIndexIfNeeded();
+}
+
 template <typename DocumentPredicate>
 inline std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
 
@@ -143,35 +443,13 @@ inline std::vector<Document> SearchServer::FindTopDocuments(const std::string_vi
 template <typename ExecutionPolicy, typename DocumentPredicate>
 inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, 
                                 const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    
-    const auto query = ParseQuery(raw_query);
-    if (query.plus_words.empty()) return {};
-
-    std::vector<Document> matched_documents = FindAllDocuments(policy, std::move(query), document_predicate);
-
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+    return FindFilteredDocuments(policy, raw_query, PredicateFilter<DocumentPredicate>{*this, document_predicate});
 }
 
 template <typename ExecutionPolicy>
 inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, 
                                 const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
-                        [status](int document_id, DocumentStatus document_status, int rating) {
-                            [document_id](){};
-                            [rating](){};
-                            return document_status == status; });
+    return FindFilteredDocuments(policy, raw_query, StatusFilter{status_documents_[static_cast<size_t>(status)]});
 }
 
 template <typename ExecutionPolicy>
@@ -180,95 +458,260 @@ inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy poli
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        const auto word_ptr = word_to_document_freqs_.find(word);
-        if (word_ptr == word_to_document_freqs_.end()) {
-            continue;
-        }
-        const auto& id_freq = word_ptr->second;
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : id_freq) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
-        }
+template <typename ExecutionPolicy, typename DocumentFilter>
+inline std::vector<Document> SearchServer::FindFilteredDocuments(ExecutionPolicy policy,
+                                const std::string_view raw_query, DocumentFilter document_filter) const {
+    const auto query = ParseQuery(raw_query);
+    if (query.plus_terms.empty()) return {};
+
+    // Top documents are selected while scoring, no need to sort all matched documents
+    return FindAllDocuments(policy, query, document_filter);
+}
+
+template <typename DocumentFilter>
+inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentFilter document_filter) const {
+    const DocumentBitmap excluded_documents = GetExcludedDocuments(query);
+    // every document of the longest posting list is matched
+    int max_document_freq = 0;
+    for (const TermId term : query.plus_terms) {
+        max_document_freq = std::max(max_document_freq, index_.GetDocumentFreq(term));
     }
-    for (const std::string_view word : query.minus_words) {
-        const auto word_ptr = word_to_document_freqs_.find(word);
-        if (word_ptr == word_to_document_freqs_.end()) {
+    DocumentAccumulator document_to_relevance(static_cast<size_t>(max_document_freq));
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const TermId term = query.plus_terms[i];
+        if (index_.GetDocumentFreq(term) == 0) {
             continue;
         }
-        const auto& id_freq = word_ptr->second;
-        for (const auto [document_id, _] : id_freq) {
-            document_to_relevance.erase(document_id);
-        }
+        const double inverse_document_freq = GetInverseDocumentFreq(query, i);
+        index_.ForEachPosting(term, [&](DocumentOrdinal ordinal, double term_freq) {
+            if (excluded_documents.Contains(ordinal)) return;
+            AccumulateRelevance(document_to_relevance, document_filter, ordinal, term_freq * inverse_document_freq);
+        });
     }
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }
-    return matched_documents;
+    TopDocuments top_documents(max_result_document_count_);
+    PushAccepted(document_to_relevance, top_documents);
+    return std::move(top_documents).Build();
 }
 
-template <typename DocumentPredicate>
+template <typename DocumentFilter>
 inline std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy policy, 
-                                const Query &query, DocumentPredicate document_predicate) const {
+                                const Query &query, DocumentFilter document_filter) const {
+    if (scoring_mode_ == ScoringMode::BLOCK_MAX_WAND) {
+        return FindAllDocumentsWand(query, document_filter);
+    }
     // Call sequenced version
-    return FindAllDocuments(query, document_predicate);
+    return FindAllDocuments(query, document_filter);
 }
 
-template <typename DocumentPredicate>
+template <typename DocumentFilter>
 inline std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, 
-                                const Query &query, DocumentPredicate document_predicate) const {
-
-    // Parallel version
-    // std::map<int, double> document_to_relevance;
-    const size_t BUCKETS = 150;
-    ConcurrentMap<int, double> document_to_relevance(BUCKETS);
-
-    // work with plus words
-    std::for_each(policy, 
-                  query.plus_words.begin(), query.plus_words.end(), 
-                  [this, &document_to_relevance, document_predicate](const std::string_view word){
-                    const auto word_ptr = word_to_document_freqs_.find(word);
-                    if (word_ptr == word_to_document_freqs_.end()) return;
-    
-                    const auto& id_freq = word_ptr->second;     // got map with all <doc_id's, freqs> for iterated plus word
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : id_freq) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;    // fill document_to_relevance here
-                        }
-                    }
-                  });
+                                const Query &query, DocumentFilter document_filter) const {
+    // Parallel version: every range of documents is scored by one task
+    return FindAllDocumentsByRanges(query, document_filter, GetParallelPartCount(),
+                                    [this](size_t part_count, const auto& score_part) {
+                                        ForEachPart(part_count, score_part);
+                                    });
+}
 
-    // work with minus words
-    std::for_each(policy,
-                  query.minus_words.begin(), query.minus_words.end(),
-                  [this, &document_to_relevance](const std::string_view word){
-                    const auto word_ptr = word_to_document_freqs_.find(word);
-                    if (word_ptr == word_to_document_freqs_.end()) return;
-
-                    const auto& id_freq = word_ptr->second;
-                    for (const auto [document_id, _] : id_freq) {
-                        document_to_relevance.Erase(document_id);
-                    }
-                  });
+template <typename DocumentFilter, typename RunParts>
+inline std::vector<Document> SearchServer::FindAllDocumentsByRanges(const Query &query, DocumentFilter document_filter,
+                                                                    size_t max_part_count, RunParts run_parts) const {
+    std::vector<std::pair<TermId, double>> plus_terms;      // {term, IDF}
+    TermId longest_term = NO_TERM;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const TermId term = query.plus_terms[i];
+        if (index_.GetDocumentFreq(term) == 0) continue;
+        plus_terms.push_back({term, GetInverseDocumentFreq(query, i)});
+        if (longest_term == NO_TERM || index_.GetDocumentFreq(term) > index_.GetDocumentFreq(longest_term)) {
+            longest_term = term;
+        }
+    }
+    if (plus_terms.empty()) return {};
+    const DocumentBitmap excluded_documents = GetExcludedDocuments(query);
+
+    const std::vector<DocumentOrdinal> part_begins = SplitDocumentRanges(longest_term, max_part_count);
+
+    std::vector<TopDocuments> part_tops(part_begins.size(), TopDocuments{max_result_document_count_});
+    const auto score_part = [&](size_t part) {
+        const DocumentOrdinal first_ordinal = part_begins[part];
+        const DocumentOrdinal last_ordinal = part + 1 < part_begins.size()
+                                             ? part_begins[part + 1] - 1
+                                             : std::numeric_limits<DocumentOrdinal>::max();
+        DocumentAccumulator document_to_relevance;
+
+        // work with plus words
+        for (const auto& [term, inverse_document_freq] : plus_terms) {
+            index_.ForEachPosting(term, first_ordinal, last_ordinal,
+                                  [&](DocumentOrdinal ordinal, double term_freq) {
+                if (excluded_documents.Contains(ordinal)) return;
+                AccumulateRelevance(document_to_relevance, document_filter, ordinal,
+                                    term_freq * inverse_document_freq);
+            });
+        }
 
-    // fill matched_documents (parallel)
-    std::map<int, double> docs = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents(docs.size());
-    transform(policy,
-              docs.begin(), docs.end(),
-              matched_documents.begin(),
-              [this](const auto item) {
-                    return Document{item.first, item.second, documents_.at(item.first).rating};
-              });
+        // select top documents of the range
+        PushAccepted(document_to_relevance, part_tops[part]);
+    };
+    run_parts(part_begins.size(), score_part);
+
+    TopDocuments top_documents(max_result_document_count_);
+    for (const TopDocuments& part_top : part_tops) {
+        top_documents.Merge(part_top);
+    }
+    return std::move(top_documents).Build();
+}
+
+template <typename Function>
+inline void SearchServer::ForEachPart(size_t part_count, Function function) const {
+    if (executor_ != nullptr) {
+        executor_->ParallelFor(part_count, function);
+        return;
+    }
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    std::for_each(std::execution::par, parts.begin(), parts.end(), function);
+}
+
+template <typename DocumentFilter>
+inline void SearchServer::AccumulateRelevance(DocumentAccumulator& document_to_relevance,
+                                              const DocumentFilter& document_filter,
+                                              DocumentOrdinal ordinal, double score) {
+    auto [entry, is_new] = document_to_relevance.Insert(ordinal);
+    if (is_new) {
+        entry.is_accepted = document_filter.Accept(ordinal);
+    }
+    if (entry.is_accepted) {
+        entry.relevance += score;
+    }
+}
+
+inline void SearchServer::PushAccepted(const DocumentAccumulator& document_to_relevance,
+                                       TopDocuments& top_documents) const {
+    document_to_relevance.ForEach([&](const DocumentAccumulator::Entry& entry) {
+        if (entry.is_accepted) {
+            top_documents.Push({documents_.GetId(entry.ordinal), entry.relevance, documents_.GetRating(entry.ordinal)});
+        }
+    });
+}
+
+template <typename DocumentFilter>
+inline std::vector<Document> SearchServer::FindAllDocumentsWand(const Query &query, DocumentFilter document_filter,
+                                                                const CancellationToken& token) const {
+    if (max_result_document_count_ == 0) return {};
+    TopDocuments top_documents(max_result_document_count_);
+
+    struct PlusTerm {
+        TermId term;
+        size_t index;                           // position at query, relevance is summed in query order
+        double inverse_document_freq;
+    };
+    std::vector<PlusTerm> plus_terms;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const TermId term = query.plus_terms[i];
+        if (index_.GetDocumentFreq(term) == 0) continue;
+        plus_terms.push_back({term, plus_terms.size(), GetInverseDocumentFreq(query, i)});
+    }
+    const DocumentBitmap excluded_documents = GetExcludedDocuments(query);
+    // Side buffer is small and not covered by skip data, it is scored exhaustively
+    {
+        DocumentAccumulator document_to_relevance;
+        for (const PlusTerm& plus_term : plus_terms) {
+            index_.ForEachPendingPosting(plus_term.term, [&](DocumentOrdinal ordinal, double term_freq) {
+                if (excluded_documents.Contains(ordinal)) return;
+                AccumulateRelevance(document_to_relevance, document_filter, ordinal,
+                                    term_freq * plus_term.inverse_document_freq);
+            });
+        }
+        PushAccepted(document_to_relevance, top_documents);
+    }
+
+    // Documents of the main array
+    struct TermCursor {
+        PostingIndex::Cursor cursor;
+        const PlusTerm* plus_term;
+        double max_score;
+    };
+    std::vector<TermCursor> cursors;
+    for (const PlusTerm& plus_term : plus_terms) {
+        auto cursor = index_.OpenCursor(plus_term.term);
+        const double max_score = cursor.GetMaxTermFreq() * plus_term.inverse_document_freq;
+        if (!cursor.IsEnd()) cursors.push_back({std::move(cursor), &plus_term, max_score});
+    }
+
+    /* Document could get into top documents, if its upper bound of relevance is greater than
+       the threshold. Tolerance covers rating order at equal relevance and rounding of sums */
+    const auto get_threshold = [&top_documents]() {
+        if (!top_documents.IsFull()) return -std::numeric_limits<double>::infinity();
+        const double worst = top_documents.GetWorst().relevance;
+        return worst - 2 * std::numeric_limits<double>::epsilon() - std::abs(worst) * 1e-12;
+    };
+    std::vector<std::pair<size_t, double>> scores;
+
+    while (!cursors.empty()) {
+        token.ThrowIfCancelled();
+        std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+            return lhs.cursor.GetDocumentId() < rhs.cursor.GetDocumentId();
+        });
+
+        // Pivot: the first cursor, at which sum of maximal scores exceeds the threshold
+        const double threshold = get_threshold();
+        double upper_bound = 0.0;
+        size_t pivot = 0;
+        for (; pivot < cursors.size(); ++pivot) {
+            upper_bound += cursors[pivot].max_score;
+            if (upper_bound > threshold) break;
+        }
+        if (pivot == cursors.size()) break;
+        const DocumentOrdinal pivot_document = cursors[pivot].cursor.GetDocumentId();
+        while (pivot + 1 < cursors.size() && cursors[pivot + 1].cursor.GetDocumentId() == pivot_document) {
+            ++pivot;
+        }
+
+        // Refine upper bound with maximal scores of blocks containing pivot document
+        double block_upper_bound = 0.0;
+        DocumentOrdinal next_document = std::numeric_limits<DocumentOrdinal>::max();
+        for (size_t i = 0; i <= pivot; ++i) {
+            const auto bound = cursors[i].cursor.GetBlockBound(pivot_document);
+            block_upper_bound += bound.max_term_freq * cursors[i].plus_term->inverse_document_freq;
+            next_document = std::min(next_document, bound.last_document_id);
+        }
+        if (block_upper_bound <= threshold) {
+            // No document before the end of the shortest block can get into top documents
+            if (next_document != std::numeric_limits<DocumentOrdinal>::max()) ++next_document;
+            if (pivot + 1 < cursors.size()) {
+                next_document = std::min(next_document, cursors[pivot + 1].cursor.GetDocumentId());
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                cursors[i].cursor.Seek(next_document);
+            }
+        } else if (cursors[0].cursor.GetDocumentId() == pivot_document) {
+            // All cursors before the pivot are at pivot document: score it
+            if (!excluded_documents.Contains(pivot_document) && document_filter.Accept(pivot_document)) {
+                scores.clear();
+                for (size_t i = 0; i <= pivot; ++i) {
+                    scores.push_back({cursors[i].plus_term->index,
+                                      cursors[i].cursor.GetTermFreq() * cursors[i].plus_term->inverse_document_freq});
+                }
+                std::sort(scores.begin(), scores.end());
+                double relevance = 0.0;
+                for (const auto& [_, score] : scores) {
+                    relevance += score;
+                }
+                top_documents.Push({documents_.GetId(pivot_document), relevance, documents_.GetRating(pivot_document)});
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                cursors[i].cursor.Next();
+            }
+        } else {
+            // Documents before the pivot document can't get into top documents
+            for (size_t i = 0; i < pivot && cursors[i].cursor.GetDocumentId() < pivot_document; ++i) {
+                cursors[i].cursor.Seek(pivot_document);
+            }
+        }
+        cursors.erase(std::remove_if(cursors.begin(), cursors.end(),
+                                     [](const TermCursor& cursor) { return cursor.cursor.IsEnd(); }),
+                      cursors.end());
+    }
 
-    return matched_documents;
+    return std::move(top_documents).Build();
 }
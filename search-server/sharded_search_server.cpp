@@ -0,0 +1,138 @@
+#include "sharded_search_server.h"
+
+#include "concurrent_map.h"
+#include "string_processing.h"
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(const string& stop_words_text, size_t shard_count)
+    : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count)
+{
+}
+
+ShardedSearchServer::ShardedSearchServer(string_view stop_words_text, size_t shard_count)
+    : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count)
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string_view document,
+                                      DocumentStatus status, const vector<int>& ratings) {
+    GetDocumentShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(execution::par, raw_query, status);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(execution::par, raw_query, DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+SearchServer::TermStats ShardedSearchServer::GetTermStats(string_view word) const {
+    SearchServer::TermStats stats;
+    for (const SearchServer& shard : shards_) {
+        stats.document_freq += shard.GetDocumentFreq(word);
+    }
+    if (stats.document_freq != 0) {
+        stats.inverse_document_freq = PostingIndex::ComputeInverseDocumentFreq(GetDocumentCount(), stats.document_freq);
+    }
+    return stats;
+}
+
+void ShardedSearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+    for (SearchServer& shard : shards_) {
+        shard.SetMaxResultDocumentCount(count);
+    }
+}
+
+size_t ShardedSearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void ShardedSearchServer::SetScoringMode(ScoringMode mode) {
+    for (SearchServer& shard : shards_) {
+        shard.SetScoringMode(mode);
+    }
+}
+
+map<string_view, double> ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return GetDocumentShard(document_id).GetWordFrequencies(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    GetDocumentShard(document_id).RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id) {
+    GetDocumentShard(document_id).RemoveDocument(policy, document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(execution::parallel_policy policy, int document_id) {
+    GetDocumentShard(document_id).RemoveDocument(policy, document_id);
+}
+
+void ShardedSearchServer::CompactIndex() {
+    for (SearchServer& shard : shards_) {
+        shard.CompactIndex();
+    }
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus>
+ShardedSearchServer::MatchDocument(execution::sequenced_policy policy, const string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(policy, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus>
+ShardedSearchServer::MatchDocument(execution::parallel_policy policy, const string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(policy, raw_query, document_id);
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t shard) const {
+    return shards_.at(shard);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return concurrent_detail::Hash(static_cast<uint64_t>(document_id)) % shards_.size();
+}
+
+SearchServer& ShardedSearchServer::GetDocumentShard(int document_id) {
+    return shards_[GetShardIndex(document_id)];
+}
+
+const SearchServer& ShardedSearchServer::GetDocumentShard(int document_id) const {
+    return shards_[GetShardIndex(document_id)];
+}
+
+SearchServer::QueryWords ShardedSearchServer::ParseQueryWords(const string_view raw_query) const {
+    // all shards have the same stop words
+    SearchServer::QueryWords query_words = shards_.front().ParseQueryWords(raw_query);
+    SearchServer::RemoveDuplicateWords(query_words);
+
+    const int document_count = GetDocumentCount();
+    for (const string_view word : query_words.plus_words) {
+        int document_freq = 0;
+        for (const SearchServer& shard : shards_) {
+            document_freq += shard.GetDocumentFreq(word);
+        }
+        query_words.inverse_document_freqs.push_back(
+                document_freq == 0 ? 0.0 : PostingIndex::ComputeInverseDocumentFreq(document_count, document_freq));
+    }
+    return query_words;
+}
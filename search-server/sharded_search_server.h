@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <exception>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+/* Search server, which partitions documents by hash of id across independent SearchServer shards.
+   Queries are parsed once, scored by every shard with global IDF (document frequencies and
+   document counts of all shards are summed) and top documents of shards are merged, so results
+   are equal to results of one SearchServer with the same documents.
+   Shards are searched, filled and cleaned concurrently: overloads without a policy use the parallel
+   one, so the document predicate must be safe to call from several threads. Sequenced policy
+   processes shards one by one */
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+    ShardedSearchServer(std::string_view stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    /* Same as SearchServer::AddDocuments. Every shard adds its part of the batch */
+    template <typename DocumentRange>
+    std::vector<std::exception_ptr> AddDocuments(const DocumentRange& documents);
+
+    template <typename ExecutionPolicy, typename DocumentRange>
+    std::vector<std::exception_ptr> AddDocuments(ExecutionPolicy policy, const DocumentRange& documents);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    /* Global document frequency and IDF of the word */
+    SearchServer::TermStats GetTermStats(std::string_view word) const;
+
+    void SetMaxResultDocumentCount(size_t count);
+    size_t GetMaxResultDocumentCount() const;
+    void SetScoringMode(ScoringMode mode);
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    void RemoveDocument(int document_id);
+    void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
+    void RemoveDocument(std::execution::parallel_policy policy, int document_id);
+
+    template <typename DocumentIdRange>
+    void RemoveDocuments(const DocumentIdRange& document_ids);
+
+    template <typename ExecutionPolicy, typename DocumentIdRange>
+    void RemoveDocuments(ExecutionPolicy policy, const DocumentIdRange& document_ids);
+
+    void CompactIndex();
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query, int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const;
+
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t shard) const;
+
+private:
+    std::vector<SearchServer> shards_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    size_t GetShardIndex(int document_id) const;
+    SearchServer& GetDocumentShard(int document_id);
+    const SearchServer& GetDocumentShard(int document_id) const;
+
+    /* Parses the query like SearchServer::ParseQuery and sets global IDF of plus words */
+    SearchServer::QueryWords ParseQueryWords(const std::string_view raw_query) const;
+
+    /* make_filter(shard) returns filter of SearchServer for the shard */
+    template <typename ExecutionPolicy, typename MakeFilter>
+    std::vector<Document> FindFilteredDocuments(ExecutionPolicy policy, const std::string_view raw_query,
+                                                MakeFilter make_filter) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+    if (shard_count == 0) {
+        using namespace std::string_literals;
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template <typename DocumentRange>
+inline std::vector<std::exception_ptr> ShardedSearchServer::AddDocuments(const DocumentRange& documents) {
+    return AddDocuments(std::execution::par, documents);
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+inline std::vector<std::exception_ptr> ShardedSearchServer::AddDocuments(ExecutionPolicy policy, const DocumentRange& documents) {
+    // split the batch by shards, keeping order of documents
+    std::vector<std::vector<DocumentRecord>> shard_documents(shards_.size());
+    std::vector<std::vector<size_t>> shard_positions(shards_.size());
+    size_t document_count = 0;
+    for (const DocumentRecord& document : documents) {
+        const size_t shard = GetShardIndex(document.id);
+        shard_documents[shard].push_back(document);
+        shard_positions[shard].push_back(document_count++);
+    }
+
+    std::vector<std::exception_ptr> errors(document_count);
+    std::vector<size_t> shards(shards_.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    std::for_each(policy,
+                  shards.begin(), shards.end(),
+                  [&](size_t shard) {
+                    const auto shard_errors = shards_[shard].AddDocuments(shard_documents[shard]);
+                    for (size_t i = 0; i < shard_errors.size(); ++i) {
+                        errors[shard_positions[shard][i]] = shard_errors[i];
+                    }
+                  });
+    return errors;
+}
+
+template <typename DocumentPredicate>
+inline std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::par, raw_query, document_predicate);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+inline std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy,
+                                const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindFilteredDocuments(policy, raw_query, [&document_predicate](const SearchServer& shard) {
+        return SearchServer::PredicateFilter<DocumentPredicate>{shard, document_predicate};
+    });
+}
+
+template <typename ExecutionPolicy>
+inline std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy,
+                                const std::string_view raw_query, DocumentStatus status) const {
+    return FindFilteredDocuments(policy, raw_query, [status](const SearchServer& shard) {
+        return SearchServer::StatusFilter{shard.status_documents_[static_cast<size_t>(status)]};
+    });
+}
+
+template <typename ExecutionPolicy>
+inline std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy,
+                                const std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentIdRange>
+inline void ShardedSearchServer::RemoveDocuments(const DocumentIdRange& document_ids) {
+    RemoveDocuments(std::execution::par, document_ids);
+}
+
+template <typename ExecutionPolicy, typename DocumentIdRange>
+inline void ShardedSearchServer::RemoveDocuments(ExecutionPolicy policy, const DocumentIdRange& document_ids) {
+    std::vector<std::vector<int>> shard_document_ids(shards_.size());
+    for (const int document_id : document_ids) {
+        shard_document_ids[GetShardIndex(document_id)].push_back(document_id);
+    }
+
+    std::vector<size_t> shards(shards_.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    std::for_each(policy,
+                  shards.begin(), shards.end(),
+                  [&](size_t shard) {
+                    if (!shard_document_ids[shard].empty()) {
+                        shards_[shard].RemoveDocuments(shard_document_ids[shard]);
+                    }
+                  });
+}
+
+template <typename ExecutionPolicy, typename MakeFilter>
+inline std::vector<Document> ShardedSearchServer::FindFilteredDocuments(ExecutionPolicy policy,
+                                const std::string_view raw_query, MakeFilter make_filter) const {
+    const SearchServer::QueryWords query_words = ParseQueryWords(raw_query);
+    if (query_words.plus_words.empty()) return {};
+
+    // every shard selects its own top documents, relevance is summed in the same order as by SearchServer
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::vector<size_t> shards(shards_.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    std::for_each(policy,
+                  shards.begin(), shards.end(),
+                  [&](size_t shard) {
+                    const SearchServer& server = shards_[shard];
+                    const auto query = server.ResolveQuery(query_words);
+                    if (query.plus_terms.empty()) return;
+                    shard_documents[shard] = server.FindAllDocuments(std::execution::seq, query, make_filter(server));
+                  });
+
+    TopDocuments top_documents(max_result_document_count_);
+    for (const auto& documents : shard_documents) {
+        for (const Document& document : documents) {
+            top_documents.Push(document);
+        }
+    }
+    return std::move(top_documents).Build();
+}
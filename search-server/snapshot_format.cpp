@@ -0,0 +1,119 @@
+#include "snapshot_format.h"
+
+#include <algorithm>
+
+using namespace std;
+
+uint64_t UpdateSnapshotChecksum(uint64_t checksum, const char* data, size_t size) {
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * FNV_PRIME;
+    }
+    return checksum;
+}
+
+SnapshotWriter::SnapshotWriter(ostream& output)
+    : output_(output) {
+    Write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    WriteValue(SNAPSHOT_VERSION);
+    WriteValue(SNAPSHOT_BYTE_ORDER_MARK);
+}
+
+void SnapshotWriter::WriteString(string_view text) {
+    WriteValue(static_cast<uint64_t>(text.size()));
+    Write(text.data(), text.size());
+}
+
+void SnapshotWriter::Finish() {
+    Align();
+    const uint64_t checksum = checksum_;
+    output_.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    output_.flush();
+    if (!output_) {
+        throw ios_base::failure("Can't write snapshot"s);
+    }
+}
+
+void SnapshotWriter::Write(const char* data, size_t size) {
+    output_.write(data, static_cast<streamsize>(size));
+    /* Checksum is computed over whole words, an incomplete word waits for the next data */
+    while (size > 0) {
+        const size_t word_offset = offset_ % sizeof(uint64_t);
+        if (word_offset == 0 && size >= sizeof(uint64_t)) {
+            const size_t words_size = size / sizeof(uint64_t) * sizeof(uint64_t);
+            checksum_ = UpdateSnapshotChecksum(checksum_, data, words_size);
+            data += words_size;
+            size -= words_size;
+            offset_ += words_size;
+            continue;
+        }
+        const size_t count = min(size, sizeof(uint64_t) - word_offset);
+        memcpy(word_ + word_offset, data, count);
+        data += count;
+        size -= count;
+        offset_ += count;
+        if (offset_ % sizeof(uint64_t) == 0) {
+            checksum_ = UpdateSnapshotChecksum(checksum_, word_, sizeof(uint64_t));
+        }
+    }
+}
+
+void SnapshotWriter::Align() {
+    static const char PADDING[SNAPSHOT_ALIGNMENT] = {};
+    Write(PADDING, (SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+    const size_t header_size = sizeof(SNAPSHOT_MAGIC) + 2 * sizeof(uint32_t);
+    if (size < header_size + sizeof(uint64_t) || memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw SnapshotError("Data isn't a search server snapshot"s);
+    }
+    if (size % SNAPSHOT_ALIGNMENT != 0) {
+        throw SnapshotError("Snapshot is truncated"s);
+    }
+    offset_ = sizeof(SNAPSHOT_MAGIC);
+    if (ReadValue<uint32_t>() != SNAPSHOT_VERSION) {
+        throw SnapshotError("Unsupported snapshot version"s);
+    }
+    if (ReadValue<uint32_t>() != SNAPSHOT_BYTE_ORDER_MARK) {
+        throw SnapshotError("Snapshot was written on a platform with other byte order"s);
+    }
+
+    size_ -= sizeof(uint64_t);
+    uint64_t checksum;
+    memcpy(&checksum, data_ + size_, sizeof(checksum));
+    if (UpdateSnapshotChecksum(SNAPSHOT_CHECKSUM_SEED, data_, size_) != checksum) {
+        throw SnapshotError("Snapshot checksum mismatch"s);
+    }
+}
+
+string_view SnapshotReader::ReadString() {
+    const uint64_t size = ReadValue<uint64_t>();
+    if (size > size_ - offset_) {
+        throw SnapshotError("Snapshot is truncated"s);
+    }
+    return {Read(size), static_cast<size_t>(size)};
+}
+
+void SnapshotReader::Finish() const {
+    if ((offset_ + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT != size_) {
+        throw SnapshotError("Snapshot has unexpected data"s);
+    }
+}
+
+const char* SnapshotReader::Read(size_t size) {
+    if (size > size_ - offset_) {
+        throw SnapshotError("Snapshot is truncated"s);
+    }
+    const char* result = data_ + offset_;
+    offset_ += size;
+    return result;
+}
+
+void SnapshotReader::Align() {
+    Read((SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "array_view.h"
+
+/* Binary snapshot of the index (SearchServer::SaveSnapshot).
+   File: header {magic, version, byte order mark}, sections of the server, trailer {checksum}.
+   Values are written as they are in memory, arrays are aligned to SNAPSHOT_ALIGNMENT
+   relative to the file start, so a mapped file can be read in place on the same platform.
+   Checksum (FNV-1a over 64-bit words, so that it runs at memory speed) covers all bytes before the trailer */
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 3;
+const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+const size_t SNAPSHOT_ALIGNMENT = 8;
+
+/* Thrown, if the data isn't a valid snapshot of this version */
+class SnapshotError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/* Size must be a multiple of 8 bytes */
+uint64_t UpdateSnapshotChecksum(uint64_t checksum, const char* data, size_t size);
+const uint64_t SNAPSHOT_CHECKSUM_SEED = 14695981039346656037ULL;
+
+class SnapshotWriter {
+public:
+    /* Writes the header */
+    explicit SnapshotWriter(std::ostream& output);
+
+    template <typename T>
+    void WriteValue(const T& value);
+
+    /* Writes size of the array and its elements, aligned */
+    template <typename T>
+    void WriteArray(ArrayView<T> values);
+
+    void WriteString(std::string_view text);
+
+    /* Writes the trailer. Throws std::ios_base::failure, if the output failed */
+    void Finish();
+
+private:
+    std::ostream& output_;
+    uint64_t offset_ = 0;
+    uint64_t checksum_ = SNAPSHOT_CHECKSUM_SEED;
+    char word_[sizeof(uint64_t)] = {};      /* incomplete word of the checksum */
+
+    void Write(const char* data, size_t size);
+    void Align();
+};
+
+/* Reads data written by SnapshotWriter. Arrays are returned as views of the data without copying */
+class SnapshotReader {
+public:
+    /* Checks the header and the checksum. data must be aligned to SNAPSHOT_ALIGNMENT */
+    SnapshotReader(const char* data, size_t size);
+
+    template <typename T>
+    T ReadValue();
+
+    template <typename T>
+    ArrayView<T> ReadArray();
+
+    std::string_view ReadString();
+
+    /* Checks, that all sections were read */
+    void Finish() const;
+
+private:
+    const char* data_;
+    size_t size_;       /* without the trailer */
+    size_t offset_ = 0;
+
+    const char* Read(size_t size);
+    void Align();
+};
+
+template <typename T>
+inline void SnapshotWriter::WriteValue(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    Write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline void SnapshotWriter::WriteArray(ArrayView<T> values) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= SNAPSHOT_ALIGNMENT);
+    WriteValue(static_cast<uint64_t>(values.size()));
+    Align();
+    Write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+inline T SnapshotReader::ReadValue() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, Read(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template <typename T>
+inline ArrayView<T> SnapshotReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= SNAPSHOT_ALIGNMENT);
+    const uint64_t size = ReadValue<uint64_t>();
+    Align();
+    if (size > (size_ - offset_) / sizeof(T)) {
+        using namespace std::string_literals;
+        throw SnapshotError("Snapshot is truncated"s);
+    }
+    return {reinterpret_cast<const T*>(Read(size * sizeof(T))), static_cast<size_t>(size)};
+}
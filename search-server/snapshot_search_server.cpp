@@ -0,0 +1,92 @@
+#include "snapshot_search_server.h"
+
+using namespace std;
+
+SnapshotSearchServer::SnapshotSearchServer(SearchServer search_server)
+    : snapshot_(make_shared<const SearchServer>(move(search_server))) {
+}
+
+SnapshotSearchServer::Snapshot SnapshotSearchServer::GetSnapshot() const {
+    return atomic_load(&snapshot_);
+}
+
+void SnapshotSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                       const vector<int>& ratings) {
+    Update([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void SnapshotSearchServer::RemoveDocument(int document_id) {
+    Update([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void SnapshotSearchServer::CompactIndex() {
+    Update([](SearchServer& search_server) {
+        search_server.CompactIndex();
+    });
+}
+
+void SnapshotSearchServer::Publish(Change& change) {
+    unique_lock lock(writer_mutex_);
+    changes_.push_back(&change);
+    change_done_.wait(lock, [this, &change]() { return change.is_done || !is_publishing_; });
+    if (change.is_done) return;
+
+    // this writer publishes all waiting changes
+    is_publishing_ = true;
+    vector<Change*> group;
+    group.swap(changes_);
+    lock.unlock();
+    PublishGroup(group);
+
+    lock.lock();
+    for (Change* change_of_group : group) {
+        change_of_group->is_done = true;
+    }
+    is_publishing_ = false;
+    lock.unlock();
+    change_done_.notify_all();
+}
+
+void SnapshotSearchServer::PublishGroup(const vector<Change*>& group) {
+    try {
+        const Snapshot current = atomic_load(&snapshot_);
+        shared_ptr<SearchServer> next;
+        bool is_changed = false;
+        // all changes are applied, throwing ones are recorded. A throwing change may leave the copy
+        // half-changed, so the copy is made again once without all of them. It's made again only
+        // if a change throws without the failed ones
+        for (bool is_failed = true; is_failed;) {
+            next = make_shared<SearchServer>(*current);
+            is_failed = false;
+            is_changed = false;
+            for (Change* change : group) {
+                if (change->error) continue;
+                try {
+                    change->function(*next);
+                    is_changed = true;
+                } catch (...) {
+                    change->error = current_exception();
+                    is_failed = true;
+                }
+            }
+        }
+        if (is_changed) {
+            atomic_store(&snapshot_, Snapshot(move(next)));
+        }
+    } catch (...) {
+        // the copy failed: nothing is published
+        for (Change* change : group) {
+            if (!change->error) {
+                change->error = current_exception();
+            }
+        }
+    }
+}
+
+int SnapshotSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+/* Search server with snapshot isolation (read-copy-update).
+   Readers take the current snapshot, an immutable SearchServer, and query it without locks:
+   the snapshot and the begin()/end() range of its documents stay unchanged while the snapshot is held.
+   Writer changes a private copy of the current server and publishes it as the next snapshot.
+   Merged postings and document term frequencies are shared between snapshots and are copied
+   only in changed chunks, other data (document attributes, dictionary, status bitmaps, side buffer
+   of the index) is copied per publish. So changes are published in groups: documents are added
+   by batches (AddDocuments(), Update()), and changes of concurrent writers are published together
+   (group commit), so that a copy is paid per group, not per change.
+   Copies are allocated from the default memory resource. Old snapshot is freed by its last reader,
+   so the resource must be thread-safe */
+class SnapshotSearchServer {
+public:
+    using Snapshot = std::shared_ptr<const SearchServer>;
+
+    explicit SnapshotSearchServer(SearchServer search_server);
+
+    Snapshot GetSnapshot() const;
+
+    /* Calls function(SearchServer&) for a copy of the current server and publishes the copy.
+       Readers aren't blocked. Changes of writers, which wait while another group is published,
+       are applied in order to one copy and published at once. Returns, when the change is published.
+       Change of a throwing function isn't published, its exception is rethrown. Function is called
+       again for a new copy, if a change of another writer of the group throws */
+    template <typename Function>
+    void Update(Function function);
+
+    /* Adds documents with one publish. Errors are returned as by SearchServer::AddDocuments */
+    template <typename DocumentRange>
+    std::vector<std::exception_ptr> AddDocuments(const DocumentRange& documents);
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    template <typename DocumentIdRange>
+    void RemoveDocuments(const DocumentIdRange& document_ids);
+    void CompactIndex();
+
+    /* Search at the current snapshot */
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+    int GetDocumentCount() const;
+
+private:
+    /* Change of a waiting writer. It lives at the stack of the writer until is_done */
+    struct Change {
+        std::function<void(SearchServer&)> function;
+        std::exception_ptr error;
+        bool is_done = false;
+    };
+
+    std::mutex writer_mutex_;
+    std::condition_variable change_done_;
+    /* Changes waiting for the next group */
+    std::vector<Change*> changes_;
+    bool is_publishing_ = false;
+    /* Accessed by std::atomic_load / std::atomic_store only */
+    Snapshot snapshot_;
+
+    /* Waits until the change is published by another writer or publishes the group itself */
+    void Publish(Change& change);
+    void PublishGroup(const std::vector<Change*>& group);
+};
+
+template <typename Function>
+inline void SnapshotSearchServer::Update(Function function) {
+    Change change;
+    change.function = [&function](SearchServer& search_server) {
+        function(search_server);
+    };
+    Publish(change);
+    if (change.error) {
+        std::rethrow_exception(change.error);
+    }
+}
+
+template <typename DocumentRange>
+inline std::vector<std::exception_ptr> SnapshotSearchServer::AddDocuments(const DocumentRange& documents) {
+    std::vector<std::exception_ptr> errors;
+    Update([&documents, &errors](SearchServer& search_server) {
+        errors = search_server.AddDocuments(documents);
+    });
+    return errors;
+}
+
+template <typename DocumentIdRange>
+inline void SnapshotSearchServer::RemoveDocuments(const DocumentIdRange& document_ids) {
+    Update([&document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+template <typename... Args>
+inline std::vector<Document> SnapshotSearchServer::FindTopDocuments(Args&&... args) const {
+    return GetSnapshot()->FindTopDocuments(std::forward<Args>(args)...);
+}
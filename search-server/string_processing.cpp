@@ -1,6 +1,7 @@
 #include <algorithm>
 
 #include "string_processing.h"
+#include "tokenizer.h"
 
 using namespace std;
 
@@ -11,20 +12,9 @@ bool IsValidWord(const string_view word) {
 
 vector<string_view> SplitIntoWords(string_view text) {
     vector<string_view> result;
-    
-    size_t space = 0;
-    for (;;) {
-        size_t not_space = text.find_first_not_of(' ', space);
-        if (not_space == text.npos) break;
-        text.remove_prefix(not_space);
-        space = text.find(' ');
-        if (space == text.npos) {
-            result.push_back(text.substr(0));
-            break;
-        }
-        result.push_back(text.substr(0, space));
+    for (Tokenizer tokenizer(text); tokenizer.Next();) {
+        result.push_back(tokenizer.GetWord());
     }
-
     return result;
 }
 
@@ -0,0 +1,95 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary(pmr::memory_resource* resource)
+    : mapped_words_(resource)
+    , words_(resource)
+    , ids_(resource) {
+}
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    /* Copy of pmr container gets the default resource, the copy must stay in the resource of other */
+    : file_(other.file_)
+    , mapped_words_(other.mapped_words_, other.words_.get_allocator().resource())
+    , words_(other.words_, other.words_.get_allocator().resource())
+    , ids_(other.words_.get_allocator().resource()) {
+    BuildIds();
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        /* Resource of this dictionary is kept. Keys of ids_ point to words of other,
+           so the map is rebuilt over the copied words */
+        file_ = other.file_;
+        mapped_words_ = other.mapped_words_;
+        words_ = other.words_;
+        ids_.clear();
+        BuildIds();
+    }
+    return *this;
+}
+
+TermDictionary& TermDictionary::operator=(TermDictionary&& other) {
+    /* Memory of other dictionary can be taken only if it is from the same resource */
+    if (words_.get_allocator() != other.words_.get_allocator()) {
+        return *this = other;
+    }
+    file_ = move(other.file_);
+    mapped_words_ = move(other.mapped_words_);
+    words_ = move(other.words_);
+    ids_ = move(other.ids_);
+    return *this;
+}
+
+TermId TermDictionary::Add(string_view word) {
+    const auto it = ids_.find(word);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    const TermId term = static_cast<TermId>(GetSize());
+    ids_.emplace(words_.emplace_back(word), term);
+    return term;
+}
+
+TermId TermDictionary::Find(string_view word) const {
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+string_view TermDictionary::GetWord(TermId term) const {
+    if (term < mapped_words_.size()) {
+        return mapped_words_[term];
+    }
+    return words_[term - mapped_words_.size()];
+}
+
+size_t TermDictionary::GetSize() const {
+    return mapped_words_.size() + words_.size();
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    writer.WriteValue(static_cast<uint64_t>(GetSize()));
+    for (TermId term = 0; term < GetSize(); ++term) {
+        writer.WriteString(GetWord(term));
+    }
+}
+
+void TermDictionary::Load(SnapshotReader& reader, shared_ptr<const MappedFile> file) {
+    const uint64_t word_count = reader.ReadValue<uint64_t>();
+    for (uint64_t i = 0; i < word_count; ++i) {
+        mapped_words_.push_back(reader.ReadString());
+    }
+    BuildIds();
+    if (ids_.size() != GetSize()) {
+        throw SnapshotError("Snapshot has repeated words"s);
+    }
+    file_ = move(file);
+}
+
+void TermDictionary::BuildIds() {
+    ids_.reserve(GetSize());
+    for (TermId term = 0; term < GetSize(); ++term) {
+        ids_.emplace(GetWord(term), term);
+    }
+}
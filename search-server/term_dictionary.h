@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "snapshot_format.h"
+
+/* Dense id of a word. Ids are assigned by TermDictionary in order of appearance */
+using TermId = std::uint32_t;
+const TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+/* Dictionary <word, term id> with hashed lookup by string_view.
+   This is the owner of all words of the server, other containers operate with term ids */
+class TermDictionary {
+public:
+    explicit TermDictionary(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    TermDictionary(TermDictionary&& other) = default;
+    TermDictionary& operator=(TermDictionary&& other);
+
+    /* Returns id of the word, registering it if it is new */
+    TermId Add(std::string_view word);
+    /* Returns id of the word or NO_TERM */
+    TermId Find(std::string_view word) const;
+    /* Returned view stays valid for dictionary lifetime */
+    std::string_view GetWord(TermId term) const;
+
+    size_t GetSize() const;
+
+    /* Writes words in order of ids */
+    void Save(SnapshotWriter& writer) const;
+    /* Reads words written by Save() into an empty dictionary. Words refer to the file */
+    void Load(SnapshotReader& reader, std::shared_ptr<const MappedFile> file);
+
+private:
+    /* Words of an opened snapshot, they have the first ids. Copies of the dictionary share the file */
+    std::shared_ptr<const MappedFile> file_;
+    std::pmr::vector<std::string_view> mapped_words_;
+    /* Words added later. deque doesn't move its elements, so keys of ids_ stay valid */
+    std::pmr::deque<std::pmr::string> words_;
+    std::pmr::unordered_map<std::string_view, TermId> ids_;
+
+    /* Fills ids_ with all words */
+    void BuildIds();
+};
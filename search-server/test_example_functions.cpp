@@ -1,6 +1,9 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
@@ -8,8 +11,30 @@
 #include <vector>
 #include <numeric>
 #include <iostream>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory_resource>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
 
+#include "async_search_server.h"
+#include "bit_packing.h"
+#include "concurrent_map.h"
+#include "corpus_loader.h"
+#include "document_bitmap.h"
+#include "document_store.h"
+#include "posting_index.h"
+#include "process_queries.h"
+#include "query_cache.h"
+#include "query_executor.h"
+#include "request_queue.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "snapshot_search_server.h"
+#include "tokenizer.h"
 
 #include "test_example_functions.h"
 
@@ -391,6 +416,1676 @@ void TestRelevanceCalculate() {
     }
 }
 
+// Индекс. Документы находятся и после слияния буфера новых документов с основным индексом,
+// удалённые документы не находятся ни до, ни после слияния.
+void TestIndexMergeAndRemove() {
+    SearchServer server("in the"s);
+    const int doc_count = 1000;
+    for (int id = 0; id < doc_count; ++id) {
+        server.AddDocument(id, "cat dog word"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    for (int id = 0; id < doc_count; id += 2) {
+        server.RemoveDocument(id);
+    }
+    assert(server.GetDocumentCount() == doc_count / 2);
+    assert(server.FindTopDocuments("word10"s).empty());
+    {
+        const auto found_docs = server.FindTopDocuments("word11"s);
+        assert(found_docs.size() == 1);
+        assert(found_docs[0].id == 11);
+    }
+    // Повторное добавление удалённого документа
+    server.AddDocument(10, "parrot"s, DocumentStatus::ACTUAL, {1});
+    assert(server.FindTopDocuments("word10"s).empty());
+    {
+        const auto found_docs = server.FindTopDocuments("parrot -word10"s);
+        assert(found_docs.size() == 1);
+        assert(found_docs[0].id == 10);
+    }
+    // Документы с максимальным рейтингом при равной релевантности
+    {
+        const auto found_docs = server.FindTopDocuments("cat"s);
+        assert(found_docs.size() == MAX_RESULT_DOCUMENT_COUNT);
+        assert(found_docs[0].id == doc_count - 1);
+    }
+}
+
+// Количество возвращаемых документов задаётся на сервере.
+// Последовательный и параллельный поиск возвращают одинаковые документы в одинаковом порядке.
+void TestMaxResultDocumentCount() {
+    SearchServer server("in the"s);
+    for (int id = 0; id < 10000; ++id) {
+        const string content = "cat"s + (id % 3 ? " dog"s : ""s) + (id % 7 ? " parrot"s : ""s);
+        server.AddDocument(id, content, DocumentStatus::ACTUAL, {id % 11});
+    }
+    assert(server.GetMaxResultDocumentCount() == MAX_RESULT_DOCUMENT_COUNT);
+    assert(server.FindTopDocuments("cat dog"s).size() == MAX_RESULT_DOCUMENT_COUNT);
+
+    for (const size_t count : {0, 1, 20, 20000}) {
+        server.SetMaxResultDocumentCount(count);
+        const auto found_docs = server.FindTopDocuments("cat dog parrot"s);
+        assert(found_docs.size() == min<size_t>(count, 10000));
+        for (size_t i = 1; i < found_docs.size(); ++i) {
+            assert(!IsMoreRelevant(found_docs[i], found_docs[i - 1]));
+        }
+        const auto par_found_docs = server.FindTopDocuments(execution::par, "cat dog parrot"s);
+        assert(par_found_docs.size() == found_docs.size());
+        for (size_t i = 0; i < found_docs.size(); ++i) {
+            assert(par_found_docs[i].id == found_docs[i].id);
+            assert(par_found_docs[i].relevance == found_docs[i].relevance);
+        }
+    }
+}
+
+// Поиск с динамическим отсечением (Block-Max WAND) возвращает те же документы, что и полный перебор.
+void TestBlockMaxWandMatchesExhaustive() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "fluffy"s, "rare"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 5000; ++id) {
+        string content;
+        for (int i = 0; i < 1 + id % 7; ++i) {
+            content += words[(id * 31 + i * i * 17) % (id % 97 ? words.size() - 1 : words.size())] + " "s;
+        }
+        server.AddDocument(id * 3, content, static_cast<DocumentStatus>(id % 4), {id % 13, id % 5});
+    }
+    for (int id = 0; id < 5000; id += 11) {
+        server.RemoveDocument(id * 3);
+    }
+    server.AddDocument(0, "rare cat"s, DocumentStatus::ACTUAL, {7});
+
+    const vector<string> queries = {"cat"s, "cat dog"s, "rare cat dog parrot"s, "fluffy -tail"s,
+                                    "brown city tail -rare"s, "rare"s, "unknown cat"s};
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return document_id % 2 == 0 && rating > 2; };
+    for (const size_t count : {1, 5, 50}) {
+        server.SetMaxResultDocumentCount(count);
+        for (const string& query : queries) {
+            server.SetScoringMode(ScoringMode::EXHAUSTIVE);
+            const auto expected = server.FindTopDocuments(query);
+            const auto expected_by_predicate = server.FindTopDocuments(query, predicate);
+            server.SetScoringMode(ScoringMode::BLOCK_MAX_WAND);
+            const auto found_docs = server.FindTopDocuments(query);
+            const auto found_by_predicate = server.FindTopDocuments(query, predicate);
+
+            assert(found_docs.size() == expected.size());
+            for (size_t i = 0; i < found_docs.size(); ++i) {
+                assert(found_docs[i].id == expected[i].id);
+                assert(found_docs[i].relevance == expected[i].relevance);
+            }
+            assert(found_by_predicate.size() == expected_by_predicate.size());
+            for (size_t i = 0; i < found_by_predicate.size(); ++i) {
+                assert(found_by_predicate[i].id == expected_by_predicate[i].id);
+            }
+        }
+    }
+}
+
+// Статистика слов: количество документов со словом и IDF, пересчитываемый при изменении количества документов.
+void TestTermStats() {
+    SearchServer server("in the"s);
+    assert(server.GetTermStats("cat"s).document_freq == 0);
+
+    server.AddDocument(1, "brown cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "brown dog"s, DocumentStatus::ACTUAL, {1});
+    {
+        const auto stats = server.GetTermStats("cat"s);
+        assert(stats.document_freq == 1);
+        assert(stats.inverse_document_freq == log(2.0 / 1));
+        assert(server.GetTermStats("brown"s).inverse_document_freq == log(2.0 / 2));
+        assert(server.GetTermStats("in"s).document_freq == 0);
+    }
+    server.AddDocument(3, "cat"s, DocumentStatus::ACTUAL, {1});
+    {
+        const auto stats = server.GetTermStats("cat"s);
+        assert(stats.document_freq == 2);
+        assert(stats.inverse_document_freq == log(3.0 / 2));
+        const auto found_docs = server.FindTopDocuments("cat"s);
+        assert(found_docs[0].relevance == 1.0 * log(3.0 / 2));
+    }
+    server.RemoveDocument(1);
+    server.RemoveDocument(3);
+    {
+        assert(server.GetTermStats("cat"s).document_freq == 0);
+        assert(server.GetTermStats("brown"s).inverse_document_freq == log(1.0 / 1));
+    }
+}
+
+// Частоты слов документа и матчинг документа в последовательном и параллельном режимах.
+void TestWordFrequenciesAndMatching() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "brown cat with brown tail"s, DocumentStatus::BANNED, {1});
+    server.AddDocument(2, "white dog"s, DocumentStatus::ACTUAL, {1});
+    {
+        const auto word_freqs = server.GetWordFrequencies(1);
+        assert(word_freqs.size() == 4);
+        assert(word_freqs.at("brown"sv) == 0.2 + 0.2);
+        assert(word_freqs.at("tail"sv) == 0.2);
+        assert(server.GetWordFrequencies(3).empty());
+    }
+    for (const auto& [words, status] : {server.MatchDocument("tail dog cat cat unknown"s, 1),
+                                        server.MatchDocument(execution::par, "tail dog cat cat unknown"s, 1)}) {
+        assert(status == DocumentStatus::BANNED);
+        assert((words == vector<string_view>{"cat"sv, "tail"sv}));
+    }
+    {
+        const auto [words, status] = server.MatchDocument(execution::par, "tail -brown"s, 1);
+        assert(words.empty());
+    }
+}
+
+// Индекс размещается в переданном сервере ресурсе памяти.
+void TestMemoryResource() {
+    pmr::monotonic_buffer_resource arena;
+    {
+        SearchServer server("in the"s, &arena);
+        assert(server.GetMemoryResource() == &arena);
+
+        // Ресурс памяти по умолчанию недоступен: все данные индекса должны размещаться в arena
+        pmr::memory_resource* default_resource = pmr::set_default_resource(pmr::null_memory_resource());
+        for (int id = 0; id < 2000; ++id) {
+            server.AddDocument(id, "cat in the city"s + to_string(id % 100), DocumentStatus::ACTUAL, {1});
+        }
+        server.RemoveDocument(1);
+        server.RemoveDocument(1500);
+        // Копия словаря размещается в ресурсе памяти исходного словаря
+        TermDictionary dictionary(&arena);
+        dictionary.Add("cat"sv);
+        const TermDictionary dictionary_copy(dictionary);
+        assert(dictionary_copy.Find("cat"sv) == 0);
+        pmr::set_default_resource(default_resource);
+
+        assert(server.GetDocumentCount() == 1998);
+        assert(server.FindTopDocuments("city1"s).size() == MAX_RESULT_DOCUMENT_COUNT);
+        assert(server.MatchDocument("cat"s, 2) == make_tuple(vector<string_view>{"cat"sv}, DocumentStatus::ACTUAL));
+    }
+    // Вся память индекса освобождается одним вызовом
+    arena.release();
+}
+
+// Пакетное добавление документов. Результат совпадает с последовательным добавлением по одному,
+// ошибки возвращаются для каждого документа.
+void TestAddDocuments() {
+    const vector<string> texts = {"brown cat with fluffy tail"s, "brown parrot in the city"s,
+                                  "brown fluffy dog with brown fluffy tail in the city"s, "white cat"s};
+    vector<DocumentRecord> records;
+    for (int id = 0; id < 3000; ++id) {
+        records.push_back({id * 2, texts[id % texts.size()], DocumentStatus::ACTUAL, {id % 10, 1}});
+    }
+    records.push_back({-1, "cat"sv, DocumentStatus::ACTUAL, {}});
+    records.push_back({2, "cat"sv, DocumentStatus::ACTUAL, {}});
+    records.push_back({1, "bad\x12word"sv, DocumentStatus::ACTUAL, {}});
+    records.push_back({1, "white tail"sv, DocumentStatus::BANNED, {5}});
+
+    SearchServer expected_server("in the"s);
+    vector<bool> expected_errors;
+    for (const auto& record : records) {
+        try {
+            expected_server.AddDocument(record.id, record.text, record.status, record.ratings);
+            expected_errors.push_back(false);
+        } catch (const invalid_argument&) {
+            expected_errors.push_back(true);
+        }
+    }
+
+    for (const bool parallel : {false, true}) {
+        SearchServer server("in the"s);
+        server.AddDocument(100000, "white cat"s, DocumentStatus::ACTUAL, {1});
+        server.RemoveDocument(100000);
+        const auto errors = parallel ? server.AddDocuments(execution::par, records) : server.AddDocuments(records);
+        assert(errors.size() == records.size());
+        for (size_t i = 0; i < errors.size(); ++i) {
+            assert(static_cast<bool>(errors[i]) == expected_errors[i]);
+        }
+        try {
+            rethrow_exception(errors[records.size() - 2]);
+        } catch (const invalid_argument& e) {
+            assert(e.what() == "Word bad\x12word is invalid"s);
+        }
+
+        assert(server.GetDocumentCount() == expected_server.GetDocumentCount());
+        for (const string& query : {"brown"s, "fluffy -dog"s, "white tail"s, "cat city"s}) {
+            const auto found_docs = server.FindTopDocuments(query);
+            const auto expected = expected_server.FindTopDocuments(query);
+            assert(found_docs.size() == expected.size());
+            for (size_t i = 0; i < found_docs.size(); ++i) {
+                assert(found_docs[i].id == expected[i].id);
+                assert(found_docs[i].relevance == expected[i].relevance);
+                assert(found_docs[i].rating == expected[i].rating);
+            }
+        }
+        assert(server.GetWordFrequencies(4) == expected_server.GetWordFrequencies(4));
+    }
+}
+
+// Параллельный поиск по диапазонам документов должен давать тот же результат, что и последовательный
+void TestParallelSearchMatchesSequential() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 12000; ++id) {
+        string content = "cat "s;
+        for (int i = 0; i < id % 5; ++i) {
+            content += words[(id * 7 + i * 13) % words.size()] + " "s;
+        }
+        server.AddDocument(id * 2 + 1, content, static_cast<DocumentStatus>(id % 4), {id % 17, id % 3});
+    }
+    for (int id = 0; id < 12000; id += 7) {
+        server.RemoveDocument(id * 2 + 1);
+    }
+    // документы в буфере индекса, ещё не слитом с основным массивом
+    for (int id = 0; id < 50; ++id) {
+        server.AddDocument(id * 2, "cat city"s, DocumentStatus::ACTUAL, {id});
+    }
+
+    const vector<string> queries = {"cat"s, "dog -tail"s, "cat parrot city"s, "brown -cat"s, "unknown"s};
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return status != DocumentStatus::BANNED && rating % 2 == 0; };
+    for (const size_t count : {1, 5, 100}) {
+        server.SetMaxResultDocumentCount(count);
+        for (const string& query : queries) {
+            const auto expected = server.FindTopDocuments(execution::seq, query, predicate);
+            const auto found_docs = server.FindTopDocuments(execution::par, query, predicate);
+            assert(found_docs.size() == expected.size());
+            for (size_t i = 0; i < found_docs.size(); ++i) {
+                assert(found_docs[i].id == expected[i].id);
+                assert(found_docs[i].relevance == expected[i].relevance);
+                assert(found_docs[i].rating == expected[i].rating);
+            }
+        }
+    }
+}
+
+// Параллельное заполнение ConcurrentMap и ConcurrentSet в обоих режимах.
+// Результат отсортирован по ключу и совпадает с последовательным заполнением std::map
+void TestConcurrentMap() {
+    vector<int> keys(20000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(i * 7919 % 5003) - 2000;
+    }
+    map<int, int> expected;
+    for (const int key : keys) {
+        expected[key] += key % 10;
+    }
+
+    ConcurrentMap<int, int> spinlock_map(7);
+    ConcurrentMap<int, int, ConcurrentMode::ATOMIC_ADD> atomic_map(0, expected.size());
+    ConcurrentSet<int> set(5);
+    for_each(execution::par, keys.begin(), keys.end(), [&](int key) {
+        spinlock_map[key].ref_to_value += key % 10;
+        atomic_map.Add(key, key % 10);
+        set.Insert(key);
+    });
+    assert(spinlock_map.BuildOrdinaryMap() == expected);
+    const vector<pair<int, int>> expected_vector(expected.begin(), expected.end());
+    assert(atomic_map.BuildSortedVector() == expected_vector);
+    const auto sorted_keys = set.BuildSortedVector();
+    assert(equal(sorted_keys.begin(), sorted_keys.end(), expected.begin(), expected.end(),
+                 [](int key, const auto& entry) { return key == entry.first; }));
+
+    for (int key = -2000; key < 3003; key += 3) {
+        assert(spinlock_map.Erase(key) == expected.erase(key));
+        set.Erase(key);
+    }
+    assert(spinlock_map.Erase(-2000) == 0);
+    assert(spinlock_map.BuildOrdinaryMap() == expected);
+    assert(set.BuildOrdinarySet().size() == expected.size());
+
+    ConcurrentMap<int, int, ConcurrentMode::ATOMIC_ADD> small_map(0, 2);
+    try {
+        for (int key = 0; key < 100; ++key) {
+            small_map.Add(key, 1);
+        }
+        assert(false);
+    } catch (const length_error&) {
+    }
+}
+
+// Битовая карта документов: разреженные и плотные блоки, добавление в произвольном порядке
+void TestDocumentBitmap() {
+    DocumentBitmap bitmap;
+    assert(bitmap.IsEmpty());
+    set<int> expected;
+    for (int i = 0; i < 10000; ++i) {
+        const int document_id = (i * 7919) % 70000;       // плотный первый блок и разреженный второй
+        bitmap.Add(document_id);
+        expected.insert(document_id);
+    }
+    for (const int document_id : {1 << 30, 5, 1 << 20}) {
+        bitmap.Add(document_id);
+        expected.insert(document_id);
+    }
+    assert(!bitmap.IsEmpty());
+    for (int document_id = 0; document_id < 140000; ++document_id) {
+        assert(bitmap.Contains(document_id) == (expected.count(document_id) > 0));
+    }
+    assert(bitmap.Contains(1 << 30) && bitmap.Contains(1 << 20) && !bitmap.Contains((1 << 30) + 1));
+
+    for (int document_id = 0; document_id < 140000; document_id += 3) {
+        bitmap.Remove(document_id);
+        expected.erase(document_id);
+    }
+    bitmap.Remove(1 << 30);
+    expected.erase(1 << 30);
+    for (int document_id = 0; document_id < 140000; ++document_id) {
+        assert(bitmap.Contains(document_id) == (expected.count(document_id) > 0));
+    }
+    assert(!bitmap.Contains(1 << 30));
+}
+
+// Поиск по статусу использует битовые карты статусов и совпадает с поиском по предикату статуса
+void TestFindByStatusMatchesPredicate() {
+    SearchServer server("in the"s);
+    for (int id = 0; id < 3000; ++id) {
+        server.AddDocument(id, id % 3 ? "cat in the city"s : "dog with cat"s, static_cast<DocumentStatus>(id % 4), {id % 11});
+    }
+    for (int id = 0; id < 3000; id += 5) {
+        server.RemoveDocument(id);
+    }
+    server.AddDocument(0, "cat"s, DocumentStatus::BANNED, {1});
+    server.AddDocument(5, "cat"s, DocumentStatus::ACTUAL, {2});
+    server.SetMaxResultDocumentCount(20);
+
+    for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                        DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+        const auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status; };
+        for (const ScoringMode mode : {ScoringMode::EXHAUSTIVE, ScoringMode::BLOCK_MAX_WAND}) {
+            server.SetScoringMode(mode);
+            for (const string& query : {"cat"s, "cat -dog"s, "city dog"s}) {
+                const auto expected = server.FindTopDocuments(query, predicate);
+                for (const auto& found_docs : {server.FindTopDocuments(query, status),
+                                               server.FindTopDocuments(execution::par, query, status)}) {
+                    assert(found_docs.size() == expected.size());
+                    for (size_t i = 0; i < found_docs.size(); ++i) {
+                        assert(found_docs[i].id == expected[i].id);
+                        assert(found_docs[i].relevance == expected[i].relevance);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Хранилище атрибутов документов: порядковые номера выдаются по порядку и не переиспользуются
+void TestDocumentStore() {
+    DocumentStore store;
+    assert(store.Add(10, 5, DocumentStatus::ACTUAL) == 0);
+    assert(store.Add(3, -1, DocumentStatus::BANNED) == 1);
+    assert(store.Find(3) == 1 && store.Find(10) == 0 && store.Find(7) == NO_DOCUMENT);
+    assert(store.GetId(1) == 3 && store.GetRating(1) == -1 && store.GetStatus(1) == DocumentStatus::BANNED);
+
+    store.Remove(0);
+    assert(store.Find(10) == NO_DOCUMENT);
+    assert(store.Add(10, 7, DocumentStatus::IRRELEVANT) == 2);
+    assert(store.GetSize() == 2 && store.GetOrdinalCount() == 3);
+
+    // Документ, добавленный повторно, ищется с новыми атрибутами
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, {2});
+    server.RemoveDocument(1);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {9});
+    const auto found_docs = server.FindTopDocuments("cat white"s);
+    assert(found_docs.size() == 2);
+    assert(found_docs[0].id == 1 && found_docs[0].rating == 9);
+    assert(found_docs[1].id == 2 && found_docs[1].rating == 2);
+    assert(server.GetWordFrequencies(1).count("white"s) == 0);
+    const auto [words, status] = server.MatchDocument("white cat"s, 1);
+    assert(words.size() == 1 && words[0] == "cat"s && status == DocumentStatus::ACTUAL);
+}
+
+// Удаление документов отложенное: до и после сжатия индекса результаты совпадают с сервером,
+// в который добавлены только оставшиеся документы
+void TestLazyRemovalAndCompaction() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s};
+    const auto make_text = [&words](int id) {
+        string text;
+        for (int i = 0; i <= id % 4; ++i) {
+            text += words[(id + i * 3) % words.size()] + " "s;
+        }
+        return text;
+    };
+    const auto is_removed = [](int id) { return id % 3 == 0 || (id > 1500 && id < 1800); };
+
+    SearchServer expected_server("in the"s);
+    for (int id = 0; id < 3000; ++id) {
+        if (!is_removed(id)) {
+            expected_server.AddDocument(id, make_text(id), static_cast<DocumentStatus>(id % 2), {id % 7});
+        }
+    }
+
+    for (const double threshold : {0.0, 0.3, 1.0}) {
+        SearchServer server("in the"s);
+        server.SetCompactionThreshold(threshold);
+        assert(server.GetCompactionThreshold() == threshold);
+        for (int id = 0; id < 3000; ++id) {
+            server.AddDocument(id, make_text(id), static_cast<DocumentStatus>(id % 2), {id % 7});
+        }
+        for (int id = 0; id < 3000; ++id) {
+            if (is_removed(id)) {
+                if (id % 2) {
+                    server.RemoveDocument(execution::par, id);
+                } else {
+                    server.RemoveDocument(id);
+                }
+            }
+        }
+        server.RemoveDocument(0);
+
+        for (const bool is_compacted : {false, true}) {
+            if (is_compacted) {
+                server.CompactIndex();
+            }
+            assert(server.GetDocumentCount() == expected_server.GetDocumentCount());
+            assert(vector<int>(server.begin(), server.end()) == vector<int>(expected_server.begin(), expected_server.end()));
+            assert(server.GetTermStats("cat"s).inverse_document_freq == expected_server.GetTermStats("cat"s).inverse_document_freq);
+            assert(server.GetWordFrequencies(3).empty());
+            assert(server.GetWordFrequencies(4) == expected_server.GetWordFrequencies(4));
+            for (const string& query : {"cat"s, "dog -tail"s, "parrot city"s}) {
+                const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT);
+                const auto found_docs = server.FindTopDocuments(query, DocumentStatus::IRRELEVANT);
+                const auto found_by_predicate = server.FindTopDocuments(execution::par, query,
+                        [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::IRRELEVANT; });
+                assert(found_docs.size() == expected.size() && found_by_predicate.size() == expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(found_docs[i].id == expected[i].id && found_by_predicate[i].id == expected[i].id);
+                    assert(found_docs[i].relevance == expected[i].relevance);
+                }
+            }
+        }
+    }
+
+    // Доля удалённых документов вне [0, 1] отвергается
+    for (const double threshold : {-0.1, 1.5, numeric_limits<double>::quiet_NaN()}) {
+        SearchServer server("in the"s);
+        try {
+            server.SetCompactionThreshold(threshold);
+            assert(false);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+// Пакетное удаление документов совпадает с удалением по одному, неизвестные и повторные id пропускаются
+void TestRemoveDocuments() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s};
+    const auto fill = [&words](SearchServer& server) {
+        for (int id = 0; id < 20000; ++id) {
+            string text;
+            for (int i = 0; i <= id % 5; ++i) {
+                text += words[(id * 7 + i) % words.size()] + " "s;
+            }
+            server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 9});
+        }
+    };
+    vector<int> removed_ids;
+    for (int id = 0; id < 20000; id += 2) {
+        removed_ids.push_back(id);
+    }
+    removed_ids.push_back(4);
+    removed_ids.push_back(-5);
+    removed_ids.push_back(100000);
+
+    SearchServer expected_server("in the"s);
+    fill(expected_server);
+    for (const int id : removed_ids) {
+        expected_server.RemoveDocument(id);
+    }
+
+    for (const bool parallel : {false, true}) {
+        SearchServer server("in the"s);
+        fill(server);
+        if (parallel) {
+            server.RemoveDocuments(execution::par, removed_ids);
+        } else {
+            server.RemoveDocuments(removed_ids);
+        }
+        server.RemoveDocuments(vector<int>{});
+        assert(server.GetDocumentCount() == expected_server.GetDocumentCount());
+        assert(vector<int>(server.begin(), server.end()) == vector<int>(expected_server.begin(), expected_server.end()));
+        for (const string& word : words) {
+            assert(server.GetTermStats(word).document_freq == expected_server.GetTermStats(word).document_freq);
+        }
+        for (const string& query : {"cat"s, "brown -dog"s, "parrot tail city"s}) {
+            const auto expected = expected_server.FindTopDocuments(query);
+            const auto found_docs = server.FindTopDocuments(execution::par, query);
+            assert(found_docs.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                assert(found_docs[i].id == expected[i].id);
+                assert(found_docs[i].relevance == expected[i].relevance);
+            }
+        }
+    }
+}
+
+// Снимок не меняется при добавлении и удалении документов, читатели видят согласованное состояние
+void TestSnapshotSearchServer() {
+    SearchServer search_server("in the"s);
+    for (int id = 0; id < 3000; ++id) {
+        search_server.AddDocument(id, "cat in the city "s + to_string(id % 7), DocumentStatus::ACTUAL, {id % 5});
+    }
+    SnapshotSearchServer server(move(search_server));
+    const auto old_snapshot = server.GetSnapshot();
+    const auto old_found = old_snapshot->FindTopDocuments("cat 3"s);
+    const vector<int> old_ids(old_snapshot->begin(), old_snapshot->end());
+
+    // читатель проверяет, что каждый снимок целостен, пока писатель меняет сервер
+    thread reader([&server] {
+        for (int i = 0; i < 200; ++i) {
+            const auto snapshot = server.GetSnapshot();
+            const vector<int> ids(snapshot->begin(), snapshot->end());
+            assert(static_cast<int>(ids.size()) == snapshot->GetDocumentCount());
+            assert(snapshot->FindTopDocuments("cat"s).size() == min<size_t>(ids.size(), MAX_RESULT_DOCUMENT_COUNT));
+        }
+    });
+    for (int id = 3000; id < 3200; ++id) {
+        server.AddDocument(id, "cat dog "s + to_string(id % 7), DocumentStatus::ACTUAL, {id % 5});
+    }
+    for (int id = 0; id < 3000; id += 3) {
+        server.RemoveDocument(id);
+    }
+    server.Update([](SearchServer& search_server) {
+        search_server.RemoveDocuments(vector<int>{1, 2});
+        search_server.AddDocument(5000, "dog"s, DocumentStatus::BANNED, {1});
+    });
+    server.CompactIndex();
+    reader.join();
+
+    // старый снимок остался прежним
+    assert(old_snapshot->GetDocumentCount() == 3000);
+    assert(vector<int>(old_snapshot->begin(), old_snapshot->end()) == old_ids);
+    const auto found_docs = old_snapshot->FindTopDocuments("cat 3"s);
+    assert(found_docs.size() == old_found.size());
+    for (size_t i = 0; i < found_docs.size(); ++i) {
+        assert(found_docs[i].id == old_found[i].id && found_docs[i].relevance == old_found[i].relevance);
+    }
+
+    // новый снимок совпадает с сервером, к которому применили те же изменения
+    SearchServer expected_server("in the"s);
+    for (int id = 0; id < 3200; ++id) {
+        if ((id >= 3000 || id % 3 != 0) && id != 1 && id != 2) {
+            expected_server.AddDocument(id, (id < 3000 ? "cat in the city "s : "cat dog "s) + to_string(id % 7),
+                                        DocumentStatus::ACTUAL, {id % 5});
+        }
+    }
+    expected_server.AddDocument(5000, "dog"s, DocumentStatus::BANNED, {1});
+    const auto snapshot = server.GetSnapshot();
+    assert(server.GetDocumentCount() == expected_server.GetDocumentCount());
+    assert(vector<int>(snapshot->begin(), snapshot->end()) == vector<int>(expected_server.begin(), expected_server.end()));
+    for (const string& query : {"cat 3"s, "dog -4"s, "city"s}) {
+        const auto expected = expected_server.FindTopDocuments(query);
+        const auto found = server.FindTopDocuments(execution::par, query);
+        assert(found.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            assert(found[i].id == expected[i].id && found[i].relevance == expected[i].relevance);
+        }
+    }
+    assert(server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size() == 1);
+}
+
+// Шардированный сервер находит те же документы с той же релевантностью, что и обычный сервер
+void TestShardedSearchServer() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s};
+    vector<string> texts;
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        for (int i = 0; i <= id % 6; ++i) {
+            text += words[(id * 5 + i * i) % words.size()] + " "s;
+        }
+        texts.push_back(text);
+    }
+    vector<DocumentRecord> records;
+    for (int id = 0; id < 3000; ++id) {
+        records.push_back({id, texts[id], static_cast<DocumentStatus>(id % 3), {id % 11, -id % 4}});
+    }
+    records.push_back({7, "duplicate"sv, DocumentStatus::ACTUAL, {}});
+    records.push_back({-1, "negative"sv, DocumentStatus::ACTUAL, {}});
+
+    SearchServer expected_server("in the"s);
+    const auto expected_errors = expected_server.AddDocuments(records);
+    ShardedSearchServer server("in the"s, 4);
+    const auto errors = server.AddDocuments(execution::par, records);
+    assert(errors.size() == expected_errors.size());
+    for (size_t i = 0; i < errors.size(); ++i) {
+        assert((errors[i] == nullptr) == (expected_errors[i] == nullptr));
+    }
+    server.AddDocument(5000, "brown parrot"s, DocumentStatus::ACTUAL, {3});
+    expected_server.AddDocument(5000, "brown parrot"s, DocumentStatus::ACTUAL, {3});
+    try {
+        server.AddDocument(5000, "cat"s, DocumentStatus::ACTUAL, {});
+        assert(false);
+    } catch (const invalid_argument&) {
+    }
+
+    const auto check = [&]() {
+        assert(server.GetDocumentCount() == expected_server.GetDocumentCount());
+        for (const string& word : words) {
+            assert(server.GetTermStats(word).document_freq == expected_server.GetTermStats(word).document_freq);
+            assert(server.GetTermStats(word).inverse_document_freq == expected_server.GetTermStats(word).inverse_document_freq);
+        }
+        const auto assert_equal = [](const vector<Document>& found_docs, const vector<Document>& expected) {
+            assert(found_docs.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                assert(found_docs[i].id == expected[i].id);
+                assert(found_docs[i].relevance == expected[i].relevance);
+            }
+        };
+        const auto predicate = [](int document_id, DocumentStatus, int rating) { return document_id % 2 == 0 && rating > 2; };
+        for (const string& query : {"cat"s, "brown -dog"s, "parrot tail city"s, "in the"s, "cat -cat"s}) {
+            assert_equal(server.FindTopDocuments(query), expected_server.FindTopDocuments(query));
+            assert_equal(server.FindTopDocuments(execution::seq, query), expected_server.FindTopDocuments(query));
+            assert_equal(server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                         expected_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            assert_equal(server.FindTopDocuments(query, predicate), expected_server.FindTopDocuments(query, predicate));
+        }
+        assert(server.MatchDocument("cat brown -tail"s, 5000) == expected_server.MatchDocument("cat brown -tail"s, 5000));
+        assert(server.MatchDocument(execution::par, "parrot city"s, 43) == expected_server.MatchDocument("parrot city"s, 43));
+    };
+    check();
+
+    server.SetMaxResultDocumentCount(20);
+    expected_server.SetMaxResultDocumentCount(20);
+    server.SetScoringMode(ScoringMode::BLOCK_MAX_WAND);
+    check();
+
+    vector<int> removed_ids;
+    for (int id = 0; id < 3000; id += 4) {
+        removed_ids.push_back(id);
+    }
+    server.RemoveDocuments(execution::par, removed_ids);
+    expected_server.RemoveDocuments(removed_ids);
+    server.RemoveDocument(42);
+    expected_server.RemoveDocument(42);
+    try {
+        server.MatchDocument("cat"s, 42);
+        assert(false);
+    } catch (const out_of_range&) {
+    }
+    server.RemoveDocument(42);
+    server.MatchDocument("cat"s, 43);
+    assert(server.GetWordFrequencies(5000) == expected_server.GetWordFrequencies(5000));
+    check();
+}
+
+// Сервер, открытый из снимка, совпадает с исходным и может изменяться дальше
+void TestIndexSnapshot() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 5000; ++id) {
+        string text;
+        for (int i = 0; i <= id % 6; ++i) {
+            text += words[(id * 3 + i * i) % words.size()] + " "s;
+        }
+        server.AddDocument(id * 2, text, static_cast<DocumentStatus>(id % 4), {id % 7, 1});
+    }
+    for (int id = 0; id < 10000; id += 14) {
+        server.RemoveDocument(id);
+    }
+    server.SetMaxResultDocumentCount(10);
+
+    const string path = (filesystem::temp_directory_path() / "search_server_test.snapshot"s).string();
+    server.SaveSnapshot(path);
+    SearchServer loaded_server = SearchServer::OpenSnapshot(path);
+
+    const auto check = [&]() {
+        assert(loaded_server.GetDocumentCount() == server.GetDocumentCount());
+        assert(loaded_server.GetMaxResultDocumentCount() == server.GetMaxResultDocumentCount());
+        assert(vector<int>(loaded_server.begin(), loaded_server.end()) == vector<int>(server.begin(), server.end()));
+        for (const string& word : words) {
+            assert(loaded_server.GetTermStats(word).document_freq == server.GetTermStats(word).document_freq);
+        }
+        for (const string& query : {"cat"s, "brown -dog"s, "parrot tail city"s, "lion"s}) {
+            for (const ScoringMode mode : {ScoringMode::EXHAUSTIVE, ScoringMode::BLOCK_MAX_WAND}) {
+                loaded_server.SetScoringMode(mode);
+                server.SetScoringMode(mode);
+                const auto expected = server.FindTopDocuments(query, DocumentStatus::BANNED);
+                const auto found_docs = loaded_server.FindTopDocuments(query, DocumentStatus::BANNED);
+                const auto found_par = loaded_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED);
+                assert(found_docs.size() == expected.size() && found_par.size() == expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(found_docs[i].id == expected[i].id && found_par[i].id == expected[i].id);
+                    assert(found_docs[i].relevance == expected[i].relevance && found_par[i].relevance == expected[i].relevance);
+                    assert(found_docs[i].rating == expected[i].rating);
+                }
+            }
+        }
+        assert(loaded_server.MatchDocument("cat parrot -tail"s, 4) == server.MatchDocument("cat parrot -tail"s, 4));
+        assert(loaded_server.GetWordFrequencies(6) == server.GetWordFrequencies(6));
+    };
+    check();
+
+    // изменения открытого сервера не затрагивают файл снимка
+    for (int id = 1; id < 3000; id += 2) {
+        server.AddDocument(id, "cat dog"s, DocumentStatus::BANNED, {id});
+        loaded_server.AddDocument(id, "cat dog"s, DocumentStatus::BANNED, {id});
+    }
+    server.RemoveDocument(2);
+    loaded_server.RemoveDocument(2);
+    check();
+    server.CompactIndex();
+    loaded_server.CompactIndex();
+    check();
+    assert(SearchServer::OpenSnapshot(path).GetDocumentCount() == 5000 - 715);
+
+    // новый снимок заменяет файл целиком, открытый из старого файла сервер продолжает работать
+    {
+        const SearchServer old_server = SearchServer::OpenSnapshot(path);
+        const auto expected = old_server.FindTopDocuments("parrot tail city"s, DocumentStatus::BANNED);
+        server.SaveSnapshot(path);
+        assert(!filesystem::exists(path + ".tmp"s));
+        assert(SearchServer::OpenSnapshot(path).GetDocumentCount() == server.GetDocumentCount());
+        const auto found_docs = old_server.FindTopDocuments("parrot tail city"s, DocumentStatus::BANNED);
+        assert(found_docs.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            assert(found_docs[i].id == expected[i].id && found_docs[i].relevance == expected[i].relevance);
+        }
+    }
+
+    // повреждённый снимок не открывается
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(1000);
+        file.put('\x7f');
+    }
+    try {
+        SearchServer::OpenSnapshot(path);
+        assert(false);
+    } catch (const SnapshotError&) {
+    }
+    filesystem::remove(path);
+    try {
+        SearchServer::OpenSnapshot(path);
+        assert(false);
+    } catch (const system_error&) {
+    }
+}
+
+// Упакованные блоки и разности номеров документов восстанавливаются без потерь при любой разрядности
+void TestBitPacking() {
+    uint32_t values[PACKED_BLOCK_SIZE];
+    uint32_t packed[PACKED_LANE_COUNT * 32];
+    uint32_t unpacked[PACKED_BLOCK_SIZE];
+    for (uint32_t bits = 0; bits <= 32; ++bits) {
+        const uint32_t mask = bits == 32 ? ~0U : (1U << bits) - 1;
+        for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+            values[i] = static_cast<uint32_t>(i * 2654435761U) & mask;
+        }
+        values[7] = mask;
+        assert(GetRequiredBits(values, PACKED_BLOCK_SIZE) == bits);
+        PackBlock(values, bits, packed);
+        UnpackBlock(packed, bits, unpacked);
+        assert(equal(values, values + PACKED_BLOCK_SIZE, unpacked));
+    }
+
+    // D4: разности с документом на 4 позиции раньше
+    uint32_t documents[PACKED_BLOCK_SIZE];
+    const uint32_t base = 1000;
+    for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+        documents[i] = base + 1 + static_cast<uint32_t>(i * i);
+        values[i] = documents[i] - (i < PACKED_LANE_COUNT ? base : documents[i - PACKED_LANE_COUNT]);
+    }
+    const uint32_t bits = GetRequiredBits(values, PACKED_BLOCK_SIZE);
+    PackBlock(values, bits, packed);
+    UnpackDeltaBlock(packed, bits, base, unpacked);
+    assert(equal(documents, documents + PACKED_BLOCK_SIZE, unpacked));
+
+    uint8_t bytes[5];
+    for (const uint32_t value : {0U, 127U, 128U, 300000U, ~0U}) {
+        uint32_t result = 0;
+        const size_t size = WriteVarint(value, bytes);
+        assert(ReadVarint(bytes, bytes + size, result) == bytes + size && result == value);
+        assert(ReadVarint(bytes, bytes + size - 1, result) == nullptr);
+    }
+}
+
+// Токенизатор разбивает текст как эталонное разбиение при любом положении слов относительно блоков
+void TestTokenizer() {
+    // Эталонное разбиение: слова между пробелами и проверка управляющих символов
+    const auto split = [](const string& text) {
+        vector<pair<string, bool>> words;
+        string word;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || text[i] == ' ') {
+                if (!word.empty()) {
+                    words.push_back({word, IsValidWord(word)});
+                }
+                word.clear();
+            } else {
+                word += text[i];
+            }
+        }
+        return words;
+    };
+
+    // Тексты разной длины, чтобы слова и управляющие символы попадали на границы блоков по 16 байт
+    const string alphabet = "ab  \x01\x1f\x7f\x80\xff-"s;
+    uint32_t state = 1;
+    for (size_t length = 0; length < 100; ++length) {
+        for (int attempt = 0; attempt < 20; ++attempt) {
+            string text;
+            for (size_t i = 0; i < length; ++i) {
+                state = state * 1103515245U + 12345U;
+                const size_t symbol = (state >> 16) % alphabet.size();
+                // управляющие символы редки, чтобы часть длинных слов была корректной
+                text += symbol == 4 || symbol == 5 ? ((state >> 8) % 8 == 0 ? alphabet[symbol] : 'c') : alphabet[symbol];
+            }
+            vector<pair<string, bool>> words;
+            for (Tokenizer tokenizer(text); tokenizer.Next();) {
+                words.push_back({string{tokenizer.GetWord()}, tokenizer.IsValid()});
+            }
+            assert(words == split(text));
+        }
+    }
+    {
+        const string text = "  "s + string(40, 'x') + "\t"s + string(40, ' ') + "y"s;
+        vector<string_view> words = SplitIntoWords(text);
+        assert(words.size() == 2 && words[0].size() == 41 && words[1] == "y"s);
+    }
+
+    // Идеальный хеш стоп-слов находит все слова набора и только их
+    {
+        vector<string> stop_words;
+        for (int i = 0; i < 1000; ++i) {
+            stop_words.push_back("stop"s + to_string(i * 7919));
+        }
+        const StopWordSet stop_word_set(stop_words);
+        for (int i = 0; i < 1000; ++i) {
+            assert(stop_word_set.Contains("stop"s + to_string(i * 7919)));
+            assert(!stop_word_set.Contains("stop"s + to_string(i * 7919 + 1)));
+        }
+        assert(!stop_word_set.Contains(""s));
+        assert(!StopWordSet().Contains("stop0"s));
+    }
+
+    // Сервер сообщает о первом некорректном слове документа
+    {
+        SearchServer server("in the"s);
+        server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+        assert(server.FindTopDocuments("the city"s).size() == 1);
+        try {
+            server.AddDocument(2, "in the\x02 dog\x03 city"s, DocumentStatus::ACTUAL, {1});
+            assert(false);
+        } catch (const invalid_argument& e) {
+            assert(e.what() == "Word the\x02 is invalid"s);
+        }
+        try {
+            server.FindTopDocuments("city -dog\x03"s);
+            assert(false);
+        } catch (const invalid_argument& e) {
+            assert(e.what() == "Query word -dog\x03 is invalid"s);
+        }
+    }
+}
+
+// Загрузка корпуса добавляет те же документы, что и AddDocument, и сообщает номера ошибочных строк
+void TestCorpusLoader() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s};
+    const vector<string> statuses = {"ACTUAL"s, "IRRELEVANT"s, "BANNED"s, "REMOVED"s};
+    SearchServer expected_server("in the"s);
+    string corpus;
+    vector<size_t> expected_error_lines;
+    size_t line = 0;
+    for (int id = 0; id < 500; ++id) {
+        string text;
+        for (int i = 0; i <= id % 6; ++i) {
+            text += words[(id * 3 + i * i) % words.size()] + " "s;
+        }
+        const int rating = id % 7 - 3;
+        corpus += to_string(id) + "\t"s + statuses[id % 4] + "\t"s + to_string(rating) + " 1\t"s + text
+                + (id % 5 == 0 ? "\r\n"s : "\n"s);
+        ++line;
+        expected_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4), {rating, 1});
+        if (id % 50 == 0) {
+            // пустая строка, повтор id, некорректное слово и строки неверного формата
+            corpus += "\n"s + to_string(id) + "\tACTUAL\t\tcat\n"s + "1000\tACTUAL\t\tdog\x01\n"s
+                    + "x\tACTUAL\t1\tcat\n"s + "1001\tNEW\t1\tcat\n"s + "1002\tACTUAL\t1 y\tcat\n"s + "1003 cat\n"s;
+            for (size_t i = 2; i <= 7; ++i) {
+                expected_error_lines.push_back(line + i);
+            }
+            line += 7;
+        }
+    }
+    corpus += "500\tBANNED\t\tcat city"s;
+    expected_server.AddDocument(500, "cat city"s, DocumentStatus::BANNED, {});
+
+    const auto check = [&](const SearchServer& server, const CorpusLoadStats& stats) {
+        assert(stats.byte_count == corpus.size());
+        assert(stats.document_count == 501);
+        assert(stats.error_lines == expected_error_lines);
+        assert(vector<int>(server.begin(), server.end()) == vector<int>(expected_server.begin(), expected_server.end()));
+        for (const string& query : {"cat"s, "brown -dog"s, "parrot tail city"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto expected = expected_server.FindTopDocuments(query, status);
+                const auto found_docs = server.FindTopDocuments(query, status);
+                assert(found_docs.size() == expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(found_docs[i].id == expected[i].id && found_docs[i].rating == expected[i].rating);
+                    assert(abs(found_docs[i].relevance - expected[i].relevance) < 1e-12);
+                }
+            }
+        }
+    };
+
+    // маленькие части, чтобы корпус разбился на много частей
+    for (const size_t chunk_size : {size_t{1}, size_t{100}, CORPUS_CHUNK_SIZE}) {
+        SearchServer server("in the"s);
+        check(server, LoadCorpus(server, corpus, chunk_size));
+    }
+
+    const string path = (filesystem::temp_directory_path() / "search_server_test.corpus"s).string();
+    {
+        ofstream file(path, ios::binary);
+        file << corpus;
+    }
+    SearchServer server("in the"s);
+    check(server, LoadCorpusFile(server, path, 1000));
+    filesystem::remove(path);
+    try {
+        LoadCorpusFile(server, path);
+        assert(false);
+    } catch (const system_error&) {
+    }
+}
+
+// Кеш возвращает результаты сервера, узнаёт одинаковые разобранные запросы и сбрасывается изменением документов
+void TestQueryCache() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "brown cat"s, DocumentStatus::BANNED, {3});
+
+    QueryCache cache(server, 4, 1);
+    const auto check = [&](const string& query, DocumentStatus status) {
+        const auto found_docs = cache.FindTopDocuments(query, status);
+        const auto expected = server.FindTopDocuments(query, status);
+        assert(found_docs.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            assert(found_docs[i].id == expected[i].id && found_docs[i].relevance == expected[i].relevance);
+        }
+    };
+    const auto stats_equal = [&](uint64_t hits, uint64_t misses, uint64_t evictions) {
+        const QueryCache::Stats stats = cache.GetStats();
+        return stats.hits == hits && stats.misses == misses && stats.evictions == evictions;
+    };
+
+    check("cat city"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(0, 1, 0));
+    // порядок слов, повторы и стоп-слова не меняют ключ
+    check("city  the cat cat"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(1, 1, 0));
+    assert(cache.FindTopDocuments("city cat"s).size() == 2);
+    assert(stats_equal(2, 1, 0));
+    check("cat city"s, DocumentStatus::BANNED);
+    check("cat -city"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(2, 3, 0));
+
+    // добавление и удаление документов делает сохранённые результаты недействительными
+    server.AddDocument(4, "cat cat city"s, DocumentStatus::ACTUAL, {4});
+    check("cat city"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(2, 4, 0));
+    server.RemoveDocument(4);
+    check("cat city"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(2, 5, 0));
+    server.SetMaxResultDocumentCount(1);
+    check("cat city"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(2, 6, 0));
+    server.SetMaxResultDocumentCount(MAX_RESULT_DOCUMENT_COUNT);
+
+    // вытесняется давно не использованный результат
+    cache.Clear();
+    for (const string& query : {"cat"s, "dog"s, "city"s, "brown"s, "cat"s, "lion"s, "cat"s}) {
+        check(query, DocumentStatus::ACTUAL);
+    }
+    assert(cache.GetSize() == 4);
+    assert(stats_equal(4, 11, 1));
+    check("dog"s, DocumentStatus::ACTUAL);
+    assert(stats_equal(4, 12, 2));
+
+    // запросы с предикатом идут мимо кеша, ошибки запроса не скрываются
+    assert(cache.FindTopDocuments("cat"s, [](int document_id, DocumentStatus, int) { return document_id == 3; }).size() == 1);
+    assert(cache.FindTopDocuments(execution::par, "cat"s, [](int, DocumentStatus, int) { return false; }).empty());
+    assert(stats_equal(4, 12, 2));
+    try {
+        cache.FindTopDocuments("cat --dog"s);
+        assert(false);
+    } catch (const invalid_argument&) {
+    }
+
+    // параллельные запросы через кеш
+    vector<string> queries;
+    for (int i = 0; i < 1000; ++i) {
+        queries.push_back(vector<string>{"cat"s, "dog city"s, "brown -cat"s, "city -dog"s, "lion"s}[i % 5]);
+    }
+    QueryCache shared_cache(server);
+    const auto found_lists = ProcessQueries(shared_cache, queries);
+    const auto expected_lists = ProcessQueries(server, queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        assert(found_lists[i].size() == expected_lists[i].size());
+        for (size_t j = 0; j < found_lists[i].size(); ++j) {
+            assert(found_lists[i][j].id == expected_lists[i][j].id);
+        }
+    }
+    const QueryCache::Stats stats = shared_cache.GetStats();
+    assert(stats.hits + stats.misses == queries.size() && stats.misses >= 5 && stats.evictions == 0);
+    assert(ProcessQueriesJoined(shared_cache, queries).size() == ProcessQueriesJoined(server, queries).size());
+
+    RequestQueue request_queue(shared_cache);
+    for (const string& query : queries) {
+        request_queue.AddFindRequest(query);
+    }
+    assert(request_queue.GetNoResultRequests() == 400);
+    assert(shared_cache.GetStats().hits == stats.hits + 2000);
+}
+
+// Статистика запросов считается за скользящее окно по минутам, перцентили задержек точны до 1/8
+void TestRequestQueue() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::BANNED, {2});
+
+    chrono::steady_clock::time_point now{chrono::hours(1000)};
+    RequestQueue request_queue(server, chrono::minutes(3), [&now]() { return now; });
+    assert(request_queue.GetRequestCount() == 0 && request_queue.GetLatencyStats().p99.count() == 0);
+
+    for (int latency = 1; latency <= 1000; ++latency) {
+        request_queue.AddRequest(latency % 10 == 0, chrono::microseconds(latency));
+    }
+    const auto check_latency = [](chrono::microseconds found, int expected) {
+        return found.count() >= expected && found.count() <= expected + expected / 8;
+    };
+    RequestQueue::LatencyStats stats = request_queue.GetLatencyStats();
+    assert(stats.request_count == 1000);
+    assert(check_latency(stats.p50, 500) && check_latency(stats.p99, 990) && check_latency(stats.p999, 999));
+    assert(check_latency(stats.max, 1000));
+    assert(request_queue.GetLatencyPercentile(0.001).count() == 1);
+    assert(request_queue.GetNoResultRequests() == 100);
+
+    // запросы через сервер в следующую минуту
+    now += chrono::minutes(1);
+    assert(request_queue.AddFindRequest("cat"s).size() == 1);
+    assert(request_queue.AddFindRequest("dog"s).empty());
+    assert(request_queue.AddFindRequest("dog"s, DocumentStatus::BANNED).size() == 1);
+    assert(request_queue.AddFindRequest("city"s, [](int, DocumentStatus, int rating) { return rating > 5; }).empty());
+    assert(request_queue.GetRequestCount() == 1004 && request_queue.GetNoResultRequests() == 102);
+
+    // первая минута выходит из окна
+    now += chrono::minutes(2);
+    assert(request_queue.GetRequestCount() == 4 && request_queue.GetNoResultRequests() == 2);
+    request_queue.AddRequest(true, chrono::seconds(2));
+    stats = request_queue.GetLatencyStats();
+    assert(stats.request_count == 5 && check_latency(stats.max, 2000000));
+    now += chrono::minutes(10);
+    assert(request_queue.GetRequestCount() == 0 && request_queue.GetNoResultRequests() == 0);
+
+    // запросы из нескольких потоков считаются без потерь
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&request_queue]() {
+            for (int j = 0; j < 10000; ++j) {
+                request_queue.AddRequest(j % 4 == 0, chrono::microseconds(j % 100));
+            }
+        });
+    }
+    for (thread& thread : threads) {
+        thread.join();
+    }
+    assert(request_queue.GetRequestCount() == 40000 && request_queue.GetNoResultRequests() == 10000);
+    // гистограммы потоков суммируются
+    assert(request_queue.GetLatencyStats().request_count == 40000);
+    assert(check_latency(request_queue.GetLatencyPercentile(0.5), 49));
+
+    // окно сдвигается по минутам, в том числе через минуты без запросов
+    RequestQueue hour_queue(server, chrono::minutes(60), [&now]() { return now; });
+    for (int minute = 0; minute < 200; ++minute) {
+        // после перерыва в 90 минут считается только текущая минута
+        now += chrono::minutes(minute % 100 == 99 ? 90 : 1);
+        hour_queue.AddRequest(minute % 2 == 0, chrono::microseconds(minute + 1));
+        hour_queue.AddRequest(false, chrono::microseconds(minute + 1));
+        const int first_minute = minute < 99 ? 0 : 99 + (minute - 99) / 100 * 100;
+        const int expected_minutes = min(minute - first_minute + 1, 60);
+        assert(hour_queue.GetRequestCount() == static_cast<uint64_t>(2 * expected_minutes));
+        assert(hour_queue.GetLatencyStats().request_count == static_cast<uint64_t>(2 * expected_minutes));
+        assert(check_latency(hour_queue.GetLatencyStats().max, minute + 1));
+    }
+}
+
+// Исполнитель вызывает каждый индекс ровно один раз, в том числе во вложенных задачах, и передаёт исключения
+void TestQueryExecutor() {
+    for (const size_t thread_count : {size_t{1}, size_t{4}}) {
+        QueryExecutor executor(thread_count);
+        assert(executor.GetThreadCount() == thread_count);
+
+        vector<atomic<int>> calls(1000);
+        executor.ParallelFor(calls.size(), [&calls](size_t i) {
+            // задачи разной длины
+            volatile size_t sum = 0;
+            for (size_t j = 0; j < (i % 10) * 1000; ++j) sum += j;
+            calls[i].fetch_add(1);
+        });
+        assert(all_of(calls.begin(), calls.end(), [](const atomic<int>& count) { return count.load() == 1; }));
+        executor.ParallelFor(0, [](size_t) { assert(false); });
+
+        atomic<int> nested_calls{0};
+        executor.ParallelFor(8, [&](size_t) {
+            executor.ParallelFor(100, [&](size_t) { nested_calls.fetch_add(1); });
+        });
+        assert(nested_calls.load() == 800);
+
+        try {
+            executor.ParallelFor(100, [](size_t i) {
+                if (i == 7) throw out_of_range("task 7"s);
+            });
+            assert(false);
+        } catch (const out_of_range& e) {
+            assert(e.what() == "task 7"s);
+        }
+    }
+
+    // запросы и параллельный поиск внутри них выполняются на одном пуле
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 20000; ++id) {
+        string text;
+        for (int i = 0; i <= id % 6; ++i) {
+            text += words[(id * 3 + i * i) % words.size()] + " "s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(words[i % words.size()] + " "s + words[(i * 5 + 1) % words.size()]);
+    }
+    const auto expected_lists = ProcessQueries(server, queries);
+
+    QueryExecutor executor(3);
+    const auto found_lists = ProcessQueries(server, queries, &executor);
+    server.SetExecutor(&executor);
+    assert(server.GetExecutor() == &executor);
+    vector<vector<Document>> par_lists(queries.size());
+    executor.ParallelFor(queries.size(), [&](size_t i) {
+        par_lists[i] = server.FindTopDocuments(execution::par, queries[i]);
+    });
+    server.SetExecutor(nullptr);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        assert(found_lists[i].size() == expected_lists[i].size() && par_lists[i].size() == expected_lists[i].size());
+        for (size_t j = 0; j < expected_lists[i].size(); ++j) {
+            assert(found_lists[i][j].id == expected_lists[i][j].id && par_lists[i][j].id == expected_lists[i][j].id);
+            assert(par_lists[i][j].relevance == expected_lists[i][j].relevance);
+        }
+    }
+    assert(ProcessQueriesJoined(server, queries, &executor).size() == ProcessQueriesJoined(server, queries).size());
+
+    // ожидающий ParallelFor не выполняет чужие задачи: пока рабочий поток занят индексом,
+    // отложенные задачи ждут рабочих потоков, а не выполняются вызывающим
+    {
+        QueryExecutor posting_executor(2);
+        const thread::id caller_id = this_thread::get_id();
+        atomic<int> posted_count{0};
+        atomic<int> finished_count{0};
+        atomic<bool> is_run_by_caller{false};
+        posting_executor.ParallelFor(2, [&](size_t) {
+            if (this_thread::get_id() != caller_id) {
+                this_thread::sleep_for(chrono::milliseconds(50));
+                return;
+            }
+            for (int i = 0; i < 20; ++i) {
+                ++posted_count;
+                posting_executor.Post([&]() {
+                    if (this_thread::get_id() == caller_id) {
+                        is_run_by_caller = true;
+                    }
+                    ++finished_count;
+                });
+            }
+            // рабочий поток берёт другой индекс
+            this_thread::sleep_for(chrono::milliseconds(20));
+        });
+        while (finished_count < posted_count) {
+            this_thread::yield();
+        }
+        assert(!is_run_by_caller);
+    }
+}
+
+// Пакетное выполнение запросов даёт те же документы и релевантность, что и выполнение по одному
+void TestProcessQueriesBatch() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s, "big"s, "small"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 20000; ++id) {
+        string text;
+        for (int i = 0; i <= id % 7; ++i) {
+            text += words[(id * 5 + i * i) % words.size()] + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), {id % 11});
+    }
+    server.RemoveDocuments(vector<int>{3, 30, 300, 3000});
+    // недавно добавленные документы ещё в буфере индекса
+    server.AddDocument(20000, "cat cat dog"s, DocumentStatus::ACTUAL, {100});
+
+    vector<string> queries;
+    for (int i = 0; i < 200; ++i) {
+        string query = words[i % words.size()] + " "s + words[(i * 7 + 2) % words.size()];
+        if (i % 3 == 0) query += " -"s + words[(i + 4) % words.size()];
+        if (i % 5 == 0) query += " the lion "s + words[i % words.size()];
+        queries.push_back(query);
+    }
+    queries.push_back("lion"s);
+    queries.push_back("-cat"s);
+    queries.push_back("the"s);
+
+    const auto check = [](const vector<vector<Document>>& found_lists, const vector<vector<Document>>& expected_lists) {
+        assert(found_lists.size() == expected_lists.size());
+        for (size_t i = 0; i < expected_lists.size(); ++i) {
+            assert(found_lists[i].size() == expected_lists[i].size());
+            for (size_t j = 0; j < expected_lists[i].size(); ++j) {
+                assert(found_lists[i][j].id == expected_lists[i][j].id);
+                assert(found_lists[i][j].relevance == expected_lists[i][j].relevance);
+                assert(found_lists[i][j].rating == expected_lists[i][j].rating);
+            }
+        }
+    };
+    check(ProcessQueriesBatch(server, queries), ProcessQueries(server, queries));
+
+    vector<vector<Document>> expected_banned;
+    for (const string& query : queries) {
+        expected_banned.push_back(server.FindTopDocuments(query, DocumentStatus::BANNED));
+    }
+    server.SetMaxResultDocumentCount(20);
+    QueryExecutor executor(3);
+    server.SetExecutor(&executor);
+    vector<vector<Document>> expected_banned_20;
+    for (const string& query : queries) {
+        expected_banned_20.push_back(server.FindTopDocuments(query, DocumentStatus::BANNED));
+    }
+    check(server.FindTopDocumentsBatch(queries, DocumentStatus::BANNED), expected_banned_20);
+    server.SetExecutor(nullptr);
+    server.SetMaxResultDocumentCount(MAX_RESULT_DOCUMENT_COUNT);
+    check(server.FindTopDocumentsBatch(queries, DocumentStatus::BANNED), expected_banned);
+
+    const auto joined = ProcessQueriesBatchJoined(server, queries);
+    const auto expected_joined = ProcessQueriesJoined(server, queries);
+    assert(joined.size() == expected_joined.size());
+    for (size_t i = 0; i < joined.size(); ++i) {
+        assert(joined[i].id == expected_joined[i].id && joined[i].relevance == expected_joined[i].relevance);
+    }
+    assert(server.FindTopDocumentsBatch({}).empty());
+    try {
+        server.FindTopDocumentsBatch({"cat"s, "dog --cat"s});
+        assert(false);
+    } catch (const invalid_argument&) {
+    }
+}
+
+// Асинхронные запросы дают те же результаты, что и синхронные, и отменяются токеном
+void TestAsyncSearchServer() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "tail"s, "brown"s, "in"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 20000; ++id) {
+        string text;
+        for (int i = 0; i <= id % 6; ++i) {
+            text += words[(id * 3 + i * i) % words.size()] + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 2), {id % 7});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(words[i % words.size()] + " "s + words[(i * 5 + 1) % words.size()] + " -"s
+                          + words[(i + 3) % words.size()]);
+    }
+
+    // поиск с токеном совпадает с обычным поиском в обоих режимах ранжирования
+    for (const ScoringMode mode : {ScoringMode::EXHAUSTIVE, ScoringMode::BLOCK_MAX_WAND}) {
+        server.SetScoringMode(mode);
+        for (const string& query : queries) {
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::BANNED);
+            const auto found = server.FindTopDocuments(query, DocumentStatus::BANNED, CancellationToken());
+            assert(found.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                assert(found[i].id == expected[i].id && found[i].relevance == expected[i].relevance);
+            }
+        }
+    }
+    server.SetScoringMode(ScoringMode::EXHAUSTIVE);
+
+    {
+        // запросов в работе намного больше, чем потоков
+        AsyncSearchServer async_server(server, 2);
+        assert(&async_server.GetSearchServer() == &server && async_server.GetExecutor().GetThreadCount() == 3);
+        vector<future<vector<Document>>> found_futures;
+        for (const string& query : queries) {
+            found_futures.push_back(async_server.FindTopDocumentsAsync(query));
+        }
+        auto match_future = async_server.MatchDocumentAsync("cat -dog"s, 1);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto found = found_futures[i].get();
+            const auto expected = server.FindTopDocuments(queries[i]);
+            assert(found.size() == expected.size());
+            for (size_t j = 0; j < expected.size(); ++j) {
+                assert(found[j].id == expected[j].id && found[j].relevance == expected[j].relevance);
+            }
+        }
+        const auto [matched_words, status] = match_future.get();
+        const auto [expected_words, expected_status] = server.MatchDocument("cat -dog"s, 1);
+        assert(matched_words == expected_words && status == expected_status);
+
+        // исключения запроса передаются через future
+        auto invalid_future = async_server.FindTopDocumentsAsync("cat --dog"s);
+        try {
+            invalid_future.get();
+            assert(false);
+        } catch (const invalid_argument&) {
+        }
+
+        // отменённый запрос не выполняется
+        CancellationSource source;
+        source.Cancel();
+        assert(source.IsCancelled() && source.GetToken().IsCancelled() && !CancellationToken().IsCancelled());
+        auto cancelled_future = async_server.FindTopDocumentsAsync("cat"s, DocumentStatus::ACTUAL, source.GetToken());
+        auto cancelled_match = async_server.MatchDocumentAsync("cat"s, 1, source.GetToken());
+        try {
+            cancelled_future.get();
+            assert(false);
+        } catch (const OperationCancelled&) {
+        }
+        try {
+            cancelled_match.get();
+            assert(false);
+        } catch (const OperationCancelled&) {
+        }
+        try {
+            server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, source.GetToken());
+            assert(false);
+        } catch (const OperationCancelled&) {
+        }
+
+        // запрос, отменённый во время выполнения, либо завершается, либо сообщает об отмене
+        CancellationSource late_source;
+        auto late_future = async_server.FindTopDocumentsAsync("cat dog city"s, DocumentStatus::ACTUAL,
+                                                              late_source.GetToken());
+        late_source.Cancel();
+        try {
+            late_future.get();
+        } catch (const OperationCancelled&) {
+        }
+    }
+
+    // асинхронные запросы и ProcessQueries выполняются на одном пуле
+    {
+        QueryExecutor executor(3);
+        server.SetExecutor(&executor);
+        server.SetScoringMode(ScoringMode::BLOCK_MAX_WAND);
+        vector<vector<Document>> expected_lists;
+        for (const string& query : queries) {
+            expected_lists.push_back(server.FindTopDocuments(query));
+        }
+        AsyncSearchServer async_server(server, executor);
+        assert(&async_server.GetExecutor() == &executor);
+        vector<future<vector<Document>>> found_futures;
+        for (const string& query : queries) {
+            found_futures.push_back(async_server.FindTopDocumentsAsync(query));
+        }
+        const auto processed_lists = ProcessQueries(server, queries, &executor);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto found = found_futures[i].get();
+            assert(found.size() == expected_lists[i].size() && processed_lists[i].size() == expected_lists[i].size());
+            for (size_t j = 0; j < found.size(); ++j) {
+                assert(found[j].id == expected_lists[i][j].id && found[j].relevance == expected_lists[i][j].relevance);
+            }
+        }
+        server.SetScoringMode(ScoringMode::EXHAUSTIVE);
+        server.SetExecutor(nullptr);
+
+        // без рабочих потоков запрос выполняется сразу в вызывающем потоке
+        QueryExecutor single_executor(1);
+        AsyncSearchServer single_async_server(server, single_executor);
+        auto ready_future = single_async_server.FindTopDocumentsAsync("cat"s);
+        assert(ready_future.wait_for(chrono::seconds(0)) == future_status::ready);
+        assert(single_async_server.GetQueueSize() == 0);
+    }
+
+    // задачи, отправленные исполнителю, завершаются до его уничтожения
+    {
+        atomic<int> task_count{0};
+        {
+            QueryExecutor executor(3);
+            for (int i = 0; i < 100; ++i) {
+                executor.Post([&task_count]() {
+                    this_thread::sleep_for(chrono::microseconds(100));
+                    ++task_count;
+                });
+            }
+        }
+        assert(task_count.load() == 100);
+    }
+
+    // переполнение очереди
+    {
+        AsyncSearchServer async_server(server, 1, 2);
+        vector<future<vector<Document>>> found_futures;
+        bool is_overflow = false;
+        for (int i = 0; i < 1000 && !is_overflow; ++i) {
+            try {
+                found_futures.push_back(async_server.FindTopDocumentsAsync("cat dog parrot city"s));
+                assert(async_server.GetQueueSize() <= 2);
+            } catch (const overflow_error&) {
+                is_overflow = true;
+            }
+        }
+        assert(is_overflow);
+        for (auto& found_future : found_futures) {
+            assert(!found_future.get().empty());
+        }
+        assert(async_server.GetQueueSize() == 0);
+    }
+    try {
+        AsyncSearchServer async_server(server, 1, 0);
+        assert(false);
+    } catch (const invalid_argument&) {
+    }
+}
+
+// Параллельный поиск по слову, у которого мало слитых блоков и много постингов в буфере индекса
+void TestParallelSearchWithSideBuffer() {
+    SearchServer server("in the"s);
+    // два блока слова cat в основном сегменте
+    for (int id = 0; id < 256; ++id) {
+        server.AddDocument(id, "cat dog"s, DocumentStatus::ACTUAL, {id % 5});
+    }
+    for (int id = 256; id < 40000; ++id) {
+        server.AddDocument(id, "dog parrot"s, DocumentStatus::ACTUAL, {id % 5});
+    }
+    server.CompactIndex();
+    // постинги новых документов остаются в буфере, он меньше 1/8 основного сегмента
+    for (int id = 40000; id < 44000; ++id) {
+        server.AddDocument(id, id % 3 == 0 ? "cat cat city"s : "cat tail"s, DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    for (const string& query : {"cat"s, "cat -city"s, "cat dog"s, "parrot cat"s}) {
+        const auto expected = server.FindTopDocuments(execution::seq, query);
+        const auto found = server.FindTopDocuments(execution::par, query);
+        const auto cancellable = server.FindTopDocuments(query, DocumentStatus::ACTUAL, CancellationToken());
+        assert(!expected.empty());
+        assert(found.size() == expected.size() && cancellable.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            assert(found[i].id == expected[i].id && found[i].relevance == expected[i].relevance);
+            assert(cancellable[i].id == expected[i].id && cancellable[i].relevance == expected[i].relevance);
+        }
+    }
+}
+
+// Части постингов слова примерно равны, даже если большая часть постингов в буфере индекса
+void TestSplitPostings() {
+    PostingIndex index;
+    const int document_count = 20000;
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        index.SetDocumentLength(document_id, 2);
+    }
+    // слово 0 есть в первых 300 документах основного сегмента, слово 1 заполняет основной сегмент
+    for (int document_id = 0; document_id < 10000; ++document_id) {
+        if (document_id < 300) index.AddPosting(0, document_id, 1);
+        index.AddPosting(1, document_id, 1);
+    }
+    index.Merge();
+    for (int document_id = 10000; document_id < document_count; document_id += 2) {
+        index.AddPosting(0, document_id, 2);
+    }
+
+    const size_t size = 300 + 5000;
+    for (const size_t part_count : {size_t{1}, size_t{2}, size_t{4}, size_t{16}}) {
+        const vector<int> part_begins = index.SplitPostings(0, part_count);
+        assert(part_begins.size() == part_count - 1);
+        assert(is_sorted(part_begins.begin(), part_begins.end()));
+        size_t total = 0;
+        for (size_t part = 0; part < part_count; ++part) {
+            const int first = part == 0 ? 0 : part_begins[part - 1];
+            const int last = part + 1 < part_count ? part_begins[part] - 1 : numeric_limits<int>::max();
+            size_t part_size = 0;
+            index.ForEachPosting(0, first, last, [&part_size](int, double) { ++part_size; });
+            // части выровнены по блокам основного сегмента
+            assert(part_size + PostingIndex::BLOCK_SIZE >= size / part_count);
+            assert(part_size <= size / part_count + PostingIndex::BLOCK_SIZE);
+            total += part_size;
+        }
+        assert(total == size);
+    }
+    assert(index.SplitPostings(1, 4).size() == 3);
+}
+
+// Слияние побочного буфера амортизировано: загрузка пакетами переписывает каждый постинг O(1) раз,
+// так что скорость загрузки корпуса не падает с ростом корпуса
+void TestBatchMergeAmortized() {
+    // пакеты по 800 документов, как части корпуса по 64 КБ у LoadCorpus
+    const int document_count = 80000;
+    const int batch_size = 800;
+    const int term_count = 2000;
+    PostingIndex index;
+    uint64_t posting_count = 0;
+    for (int first_document = 0; first_document < document_count; first_document += batch_size) {
+        vector<PostingIndex::TermPosting> batch;
+        for (int document = first_document; document < first_document + batch_size; ++document) {
+            index.SetDocumentLength(document, 10);
+            for (int i = 0; i < 10; ++i) {
+                batch.push_back({static_cast<TermId>((document * 7 + i * 211) % term_count), {document, 1}});
+            }
+        }
+        sort(batch.begin(), batch.end(), [](const auto& lhs, const auto& rhs) {
+            return make_pair(lhs.term, lhs.posting.document_id) < make_pair(rhs.term, rhs.posting.document_id);
+        });
+        posting_count += batch.size();
+        index.AddPostings(batch);
+    }
+    // при перестройке основного сегмента на каждый пакет было бы ~50 постингов на добавленный
+    assert(index.GetRebuiltPostingCount() <= 12 * posting_count);
+
+    index.Merge();
+    uint64_t total = 0;
+    for (TermId term = 0; term < term_count; ++term) {
+        assert(index.GetDocumentFreq(term) == static_cast<int>(posting_count / term_count));
+        index.ForEachPosting(term, [&total](int, double) { ++total; });
+    }
+    assert(total == posting_count);
+}
+
+// Изменения нескольких писателей публикуются группами, ошибка одного изменения не мешает остальным
+void TestSnapshotGroupCommit() {
+    SearchServer search_server("in the"s);
+    for (int id = 0; id < 2000; ++id) {
+        search_server.AddDocument(id, "cat in the city "s + to_string(id % 7), DocumentStatus::ACTUAL, {id % 5});
+    }
+    SnapshotSearchServer server(move(search_server));
+
+    vector<DocumentRecord> records;
+    const vector<string> texts = {"dog"s, "parrot"s, "bad\x01"s};
+    for (int id = 2000; id < 2003; ++id) {
+        records.push_back({id, texts[id - 2000], DocumentStatus::BANNED, {1}});
+    }
+    const auto old_snapshot = server.GetSnapshot();
+    const auto errors = server.AddDocuments(records);
+    assert(errors.size() == 3 && !errors[0] && !errors[1] && errors[2]);
+    assert(server.GetDocumentCount() == 2002 && old_snapshot->GetDocumentCount() == 2000);
+
+    // писатели добавляют документы одновременно, повтор id отвергается только у своего писателя
+    atomic<int> error_count{0};
+    vector<thread> writers;
+    for (int writer = 0; writer < 4; ++writer) {
+        writers.emplace_back([&server, &error_count, writer]() {
+            for (int i = 0; i < 50; ++i) {
+                const int id = i % 10 == 0 ? i : 3000 + writer * 100 + i;
+                try {
+                    server.AddDocument(id, "dog "s + to_string(i % 3), DocumentStatus::ACTUAL, {writer});
+                } catch (const invalid_argument&) {
+                    ++error_count;
+                }
+            }
+        });
+    }
+    for (thread& writer : writers) {
+        writer.join();
+    }
+    assert(error_count.load() == 4 * 5);
+    assert(server.GetDocumentCount() == 2002 + 4 * 45);
+    const auto snapshot = server.GetSnapshot();
+    for (int writer = 0; writer < 4; ++writer) {
+        for (int i = 1; i < 50; ++i) {
+            if (i % 10 != 0) {
+                assert(snapshot->MatchDocument("dog"s, 3000 + writer * 100 + i) == snapshot->MatchDocument("dog"s, 3001));
+            }
+        }
+    }
+
+    // изменение, бросившее исключение, не публикуется
+    try {
+        server.Update([](SearchServer& search_server) {
+            search_server.RemoveDocument(0);
+            throw runtime_error("failed"s);
+        });
+        assert(false);
+    } catch (const runtime_error& e) {
+        assert(e.what() == "failed"s);
+    }
+    assert(server.GetSnapshot() == snapshot);
+
+    // ошибки писателей группы стоят одной повторной копии: остальные изменения вызываются не более двух раз
+    {
+        atomic<bool> is_released{false};
+        thread blocker([&server, &is_released]() {
+            server.Update([&is_released](SearchServer&) {
+                while (!is_released) {
+                    this_thread::yield();
+                }
+            });
+        });
+        this_thread::sleep_for(chrono::milliseconds(20));
+        vector<atomic<int>> call_counts(8);
+        vector<thread> group_writers;
+        for (int writer = 0; writer < 8; ++writer) {
+            group_writers.emplace_back([&server, &call_counts, writer]() {
+                try {
+                    server.Update([&call_counts, writer](SearchServer& search_server) {
+                        ++call_counts[writer];
+                        if (writer % 2 == 0) {
+                            throw runtime_error("failed"s);
+                        }
+                        search_server.AddDocument(5000 + writer, "parrot"s, DocumentStatus::ACTUAL, {1});
+                    });
+                    assert(writer % 2 == 1);
+                } catch (const runtime_error&) {
+                    assert(writer % 2 == 0);
+                }
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+        is_released = true;
+        blocker.join();
+        for (thread& writer : group_writers) {
+            writer.join();
+        }
+        for (int writer = 0; writer < 8; ++writer) {
+            assert(call_counts[writer] >= 1 && call_counts[writer] <= 2);
+        }
+        assert(server.GetDocumentCount() == 2002 + 4 * 45 + 4);
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     TestAddDocumentContent();
@@ -402,6 +2097,35 @@ void TestSearchServer() {
     TestFindDocumentsByUserPredicate();
     TestFindDocumentsWithCertainStatus();
     TestRelevanceCalculate();
+    TestIndexMergeAndRemove();
+    TestMaxResultDocumentCount();
+    TestBlockMaxWandMatchesExhaustive();
+    TestTermStats();
+    TestWordFrequenciesAndMatching();
+    TestMemoryResource();
+    TestAddDocuments();
+    TestParallelSearchMatchesSequential();
+    TestConcurrentMap();
+    TestDocumentBitmap();
+    TestFindByStatusMatchesPredicate();
+    TestDocumentStore();
+    TestLazyRemovalAndCompaction();
+    TestRemoveDocuments();
+    TestSnapshotSearchServer();
+    TestShardedSearchServer();
+    TestIndexSnapshot();
+    TestBitPacking();
+    TestTokenizer();
+    TestCorpusLoader();
+    TestQueryCache();
+    TestRequestQueue();
+    TestQueryExecutor();
+    TestProcessQueriesBatch();
+    TestAsyncSearchServer();
+    TestParallelSearchWithSideBuffer();
+    TestSplitPostings();
+    TestBatchMergeAmortized();
+    TestSnapshotGroupCommit();
 }
 
 // --------- Окончание модульных тестов поисковой системы -----------
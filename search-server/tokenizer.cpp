@@ -0,0 +1,160 @@
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+bool IsControl(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+} // namespace
+
+#if defined(__SSE2__)
+
+bool Tokenizer::Next() {
+    const size_t CHUNK_SIZE = 16;
+    const char* data = text_.data();
+    const size_t size = text_.size();
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+
+    // skip spaces
+    size_t begin = position_;
+    while (begin < size) {
+        if (begin + CHUNK_SIZE <= size) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + begin));
+            const unsigned not_spaces = ~_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces)) & 0xFFFF;
+            if (not_spaces != 0) {
+                begin += __builtin_ctz(not_spaces);
+                break;
+            }
+            begin += CHUNK_SIZE;
+        } else if (data[begin] == ' ') {
+            ++begin;
+        } else {
+            break;
+        }
+    }
+    if (begin >= size) {
+        position_ = size;
+        return false;
+    }
+
+    // find the end of the word and control characters before it
+    size_t end = begin;
+    bool is_valid = true;
+    while (end + CHUNK_SIZE <= size) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + end));
+        const unsigned word_end = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces));
+        const unsigned controls = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(chunk, minus_one),
+                                                                  _mm_cmplt_epi8(chunk, spaces)));
+        if (word_end != 0) {
+            const unsigned length = __builtin_ctz(word_end);
+            is_valid = is_valid && (controls & ((1U << length) - 1)) == 0;
+            end += length;
+            word_ = text_.substr(begin, end - begin);
+            is_valid_ = is_valid;
+            position_ = end;
+            return true;
+        }
+        is_valid = is_valid && controls == 0;
+        end += CHUNK_SIZE;
+    }
+    for (; end < size && data[end] != ' '; ++end) {
+        is_valid = is_valid && !IsControl(data[end]);
+    }
+    word_ = text_.substr(begin, end - begin);
+    is_valid_ = is_valid;
+    position_ = end;
+    return true;
+}
+
+#else
+
+bool Tokenizer::Next() {
+    const char* data = text_.data();
+    const size_t size = text_.size();
+    size_t begin = position_;
+    while (begin < size && data[begin] == ' ') {
+        ++begin;
+    }
+    if (begin >= size) {
+        position_ = size;
+        return false;
+    }
+    size_t end = begin;
+    bool is_valid = true;
+    for (; end < size && data[end] != ' '; ++end) {
+        is_valid = is_valid && !IsControl(data[end]);
+    }
+    word_ = text_.substr(begin, end - begin);
+    is_valid_ = is_valid;
+    position_ = end;
+    return true;
+}
+
+#endif
+
+bool StopWordSet::Contains(string_view word) const {
+    if (slots_.empty()) {
+        return false;
+    }
+    const int index = slots_[Hash(word, seed_) & (slots_.size() - 1)];
+    return index >= 0 && words_[index] == word;
+}
+
+uint64_t StopWordSet::Hash(string_view word, uint64_t seed) {
+    const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = seed ^ (word.size() * MULTIPLIER);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= word.size(); i += sizeof(uint64_t)) {
+        uint64_t chunk;
+        memcpy(&chunk, word.data() + i, sizeof(chunk));
+        hash = (hash ^ chunk) * MULTIPLIER;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, word.data() + i, word.size() - i);
+    hash = (hash ^ tail) * MULTIPLIER;
+    return hash ^ (hash >> 32);
+}
+
+void StopWordSet::Build() {
+    sort(words_.begin(), words_.end());
+    words_.erase(unique(words_.begin(), words_.end()), words_.end());
+    if (words_.empty()) {
+        slots_.clear();
+        return;
+    }
+
+    /* Seeds are tried until all words get different slots. Table is enlarged,
+       if it takes too many attempts */
+    const uint64_t MAX_SEED_ATTEMPTS = 64;
+    size_t slot_count = 1;
+    while (slot_count < 2 * words_.size()) {
+        slot_count *= 2;
+    }
+    for (;; slot_count *= 2) {
+        for (uint64_t seed = 0; seed < MAX_SEED_ATTEMPTS; ++seed) {
+            slots_.assign(slot_count, -1);
+            bool is_perfect = true;
+            for (size_t i = 0; i < words_.size() && is_perfect; ++i) {
+                int& slot = slots_[Hash(words_[i], seed) & (slot_count - 1)];
+                is_perfect = slot < 0;
+                slot = static_cast<int>(i);
+            }
+            if (is_perfect) {
+                seed_ = seed;
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Splits text into words separated by spaces. Word boundaries and control characters
+   (codes 0..31) are found in one pass over the text, 16 bytes at a time with SSE2
+   or byte by byte by the scalar fallback */
+class Tokenizer {
+public:
+    explicit Tokenizer(std::string_view text)
+        : text_(text) {
+    }
+
+    /* Moves to the next word. Returns false, if there are no more words */
+    bool Next();
+
+    std::string_view GetWord() const {
+        return word_;
+    }
+    /* Word has no control characters */
+    bool IsValid() const {
+        return is_valid_;
+    }
+
+private:
+    std::string_view text_;
+    size_t position_ = 0;
+    std::string_view word_;
+    bool is_valid_ = true;
+};
+
+/* Set of words with lookup by a perfect hash: every word has its own slot,
+   so that lookup is one hash computation and at most one comparison */
+class StopWordSet {
+public:
+    StopWordSet() = default;
+    template <typename StringContainer>
+    explicit StopWordSet(const StringContainer& words);
+
+    bool Contains(std::string_view word) const;
+
+private:
+    std::vector<std::string> words_;
+    std::vector<int> slots_;        /* index of the word or -1 */
+    uint64_t seed_ = 0;
+
+    static uint64_t Hash(std::string_view word, uint64_t seed);
+    void Build();
+};
+
+template <typename StringContainer>
+StopWordSet::StopWordSet(const StringContainer& words)
+    : words_(words.begin(), words.end()) {
+    Build();
+}
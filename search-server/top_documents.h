@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "document.h"
+
+/* Search results order: by relevance descending, documents with equal relevance by rating descending.
+   Document id is the last key, so that the order doesn't depend on selection algorithm */
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+/* Keeps the best `capacity` of pushed documents in a bounded heap.
+   The least relevant of kept documents is at the top of the heap */
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity) : capacity_(capacity) {
+        heap_.reserve(capacity);
+    }
+
+    void Push(const Document& document) {
+        if (heap_.size() < capacity_) {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        } else if (capacity_ > 0 && IsMoreRelevant(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other.heap_) {
+            Push(document);
+        }
+    }
+
+    bool IsFull() const {
+        return heap_.size() == capacity_;
+    }
+
+    /* The least relevant of kept documents. Heap must be non-empty */
+    const Document& GetWorst() const {
+        return heap_.front();
+    }
+
+    /* Returns kept documents, the most relevant first */
+    std::vector<Document> Build() && {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        return std::move(heap_);
+    }
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};